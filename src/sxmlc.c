@@ -39,6 +39,39 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#if !defined(SXMLC_NO_SIMD) && !defined(SXMLC_UNICODE)
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SXMLC_SCAN_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SXMLC_SCAN_SSE2
+#endif
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if defined(SXMLC_NO_MMAP)
+#elif defined(WIN32) || defined(WIN64)
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#if defined(SXMLC_NO_THREADS)
+#elif defined(WIN32) || defined(WIN64)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#ifdef SXMLC_ZLIB
+#include <limits.h>
+#include <zlib.h>
+#endif
 #include "sxmlc.h"
 
 /*
@@ -48,18 +81,7 @@
  The 'tag_type' member is a constant that is associated to such tag.
  All 'len_*' members are basically the "sx_strlen()" of 'start' and 'end' members.
  */
-typedef struct _Tag {
-	TagType tag_type;
-	SXML_CHAR* start;
-	int len_start;
-	SXML_CHAR* end;
-	int len_end;
-} _TAG;
-
-typedef struct _SpecialTag {
-	_TAG *tags;
-	int n_tags;
-} SPECIAL_TAG;
+typedef XMLUserTag _TAG;
 
 /*
  List of "special" tags handled by sxmlc.
@@ -74,16 +96,88 @@ static _TAG _spec[] = {
 static int NB_SPECIAL_TAGS = (int)(sizeof(_spec) / sizeof(_TAG)); /* Auto computation of number of special tags */
 
 /*
- User-registered tags.
+ Tell whether the character 'c' following '<' can start a special tag or "<!DOCTYPE", or a user tag
+ of context 'ctx'. Tags starting with other characters are elements.
  */
-static SPECIAL_TAG _user_tags = { NULL, 0 };
+#define IS_SPECIAL_TAG_CHAR(c) ((c) == C2SX('?') || (c) == C2SX('!'))
+#define USER_TAG_CHAR(c) ((unsigned int)(c) & 0xFF)
+#define IS_USER_TAG_CHAR(ctx, c) ((ctx)->user_tag_chars[USER_TAG_CHAR(c) >> 3] & (1 << (USER_TAG_CHAR(c) & 7)))
 
-int XML_register_user_tag(TagType tag_type, SXML_CHAR* start, SXML_CHAR* end)
+/*
+ Context used by functions without a '_ctx' suffix, holding user-registered tags.
+ */
+static XMLContext _default_ctx = { NULL, 0, NULL, NULL, NULL, 0, 0, 0, false, false, { 0 }, XML_INIT_DONE };
+
+static void* _ctx_realloc(const XMLContext* ctx, void* mem, size_t sz)
+{
+	return (ctx->mem_realloc != NULL ? ctx->mem_realloc(mem, sz) : __realloc(mem, sz));
+}
+
+static void _ctx_free(const XMLContext* ctx, void* mem)
+{
+	if (ctx->mem_free != NULL)
+		ctx->mem_free(mem);
+	else
+		__free(mem);
+}
+
+int XMLContext_init(XMLContext* ctx)
+{
+	if (ctx == NULL)
+		return false;
+
+	ctx->user_tags = NULL;
+	ctx->n_user_tags = 0;
+	ctx->regexpr_compare = NULL;
+	ctx->mem_realloc = NULL;
+	ctx->mem_free = NULL;
+	ctx->max_token = 0;
+	ctx->max_attributes = 0;
+	ctx->max_depth = 0;
+	ctx->lazy_lines = false;
+	ctx->decode_entities = false;
+	memset(ctx->user_tag_chars, 0, sizeof(ctx->user_tag_chars));
+	ctx->init_value = XML_INIT_DONE;
+
+	return true;
+}
+
+/*
+ Rebuild the set of characters following '<' in the user tags of 'ctx'.
+ */
+static void _ctx_index_user_tags(XMLContext* ctx)
+{
+	unsigned int c;
+	int i;
+
+	memset(ctx->user_tag_chars, 0, sizeof(ctx->user_tag_chars));
+	for (i = 0; i < ctx->n_user_tags; i++) {
+		if (ctx->user_tags[i].len_start < 2) { /* "<" alone matches any tag */
+			memset(ctx->user_tag_chars, 0xff, sizeof(ctx->user_tag_chars));
+			return;
+		}
+		c = USER_TAG_CHAR(ctx->user_tags[i].start[1]);
+		ctx->user_tag_chars[c >> 3] |= (unsigned char)(1 << (c & 7));
+	}
+}
+
+int XMLContext_free(XMLContext* ctx)
+{
+	if (ctx == NULL || ctx->init_value != XML_INIT_DONE)
+		return false;
+
+	if (ctx->user_tags != NULL)
+		_ctx_free(ctx, ctx->user_tags);
+
+	return XMLContext_init(ctx);
+}
+
+int XMLContext_register_user_tag(XMLContext* ctx, TagType tag_type, SXML_CHAR* start, SXML_CHAR* end)
 {
 	_TAG* p;
 	int i, n, le;
 
-	if (tag_type < TAG_USER)
+	if (ctx == NULL || ctx->init_value != XML_INIT_DONE || tag_type < TAG_USER)
 		return -1;
 
 	if (start == NULL || end == NULL || *start != C2SX('<'))
@@ -93,9 +187,9 @@ int XML_register_user_tag(TagType tag_type, SXML_CHAR* start, SXML_CHAR* end)
 	if (end[le-1] != C2SX('>'))
 		return -1;
 
-	i = _user_tags.n_tags;
+	i = ctx->n_user_tags;
 	n = i + 1;
-	p = (_TAG*)__realloc(_user_tags.tags, n * sizeof(_TAG));
+	p = (_TAG*)_ctx_realloc(ctx, ctx->user_tags, n * sizeof(_TAG));
 	if (p == NULL)
 		return -1;
 
@@ -104,65 +198,172 @@ int XML_register_user_tag(TagType tag_type, SXML_CHAR* start, SXML_CHAR* end)
 	p[i].end = end;
 	p[i].len_start = sx_strlen(start);
 	p[i].len_end = le;
-	_user_tags.tags = p;
-	_user_tags.n_tags = n;
+	ctx->user_tags = p;
+	ctx->n_user_tags = n;
+	_ctx_index_user_tags(ctx);
 
 	return i;
 }
 
-int XML_unregister_user_tag(int i_tag)
+int XMLContext_unregister_user_tag(XMLContext* ctx, int i_tag)
 {
 	_TAG* pt;
 
-	if (i_tag < 0 || i_tag >= _user_tags.n_tags)
+	if (ctx == NULL || ctx->init_value != XML_INIT_DONE || i_tag < 0 || i_tag >= ctx->n_user_tags)
  		return -1;
 
-	if (_user_tags.n_tags == 1)
+	if (ctx->n_user_tags == 1)
 		pt = NULL;
 	else {
-		pt = (_TAG*)__malloc((_user_tags.n_tags - 1) * sizeof(_TAG));
+		pt = (_TAG*)_ctx_realloc(ctx, NULL, (ctx->n_user_tags - 1) * sizeof(_TAG));
 		if (pt == NULL)
 			return -1;
 	}
  
 	if (pt != NULL) {
-		memcpy(pt, _user_tags.tags, i_tag * sizeof(_TAG));
-		memcpy(&pt[i_tag], &_user_tags.tags[i_tag + 1], (_user_tags.n_tags - i_tag - 1) * sizeof(_TAG));
+		memcpy(pt, ctx->user_tags, i_tag * sizeof(_TAG));
+		memcpy(&pt[i_tag], &ctx->user_tags[i_tag + 1], (ctx->n_user_tags - i_tag - 1) * sizeof(_TAG));
 	}
-	if (_user_tags.tags != NULL)
-		__free(_user_tags.tags);
-	_user_tags.tags = pt;
-	_user_tags.n_tags--;
+	if (ctx->user_tags != NULL)
+		_ctx_free(ctx, ctx->user_tags);
+	ctx->user_tags = pt;
+	ctx->n_user_tags--;
+	_ctx_index_user_tags(ctx);
+
+	return ctx->n_user_tags;
+}
+
+int XML_register_user_tag(TagType tag_type, SXML_CHAR* start, SXML_CHAR* end)
+{
+	return XMLContext_register_user_tag(&_default_ctx, tag_type, start, end);
+}
 
-	return _user_tags.n_tags;
+int XML_unregister_user_tag(int i_tag)
+{
+	return XMLContext_unregister_user_tag(&_default_ctx, i_tag);
 }
 
 int XML_get_nb_registered_user_tags(void)
 {
-	return _user_tags.n_tags;
+	return _default_ctx.n_user_tags;
 }
 
 int XML_get_registered_user_tag(TagType tag_type)
 {
 	int i;
 
-	for (i = 0; i < _user_tags.n_tags; i++)
-		if (_user_tags.tags[i].tag_type == tag_type)
+	for (i = 0; i < _default_ctx.n_user_tags; i++)
+		if (_default_ctx.user_tags[i].tag_type == tag_type)
 			return i;
 
 	return -1;
 }
 
+/* --- Document arena --- */
+
+/*
+ Chunk of an arena, followed by its 'size' bytes of data.
+ */
+typedef struct _XMLArenaChunk {
+	struct _XMLArenaChunk* next;
+	size_t size;
+	size_t used;
+} XMLArenaChunk;
+
+/* Alignment of blocks, and of the data following the chunk header */
+#define ARENA_ALIGN(sz) (((sz) + sizeof(void*) - 1) & ~(sizeof(void*) - 1))
+#define ARENA_DATA(ck) ((char*)(ck) + ARENA_ALIGN(sizeof(XMLArenaChunk)))
+
+/*
+ Allocate 'size' bytes from 'arena'. Blocks larger than the chunk size get their own chunk,
+ placed after the current one so that it can still be filled.
+ Return NULL for memory error.
+ */
+static void* _arena_alloc(XMLArena* arena, size_t size)
+{
+	XMLArenaChunk* ck = arena->chunks;
+	size_t sz;
+
+	size = ARENA_ALIGN(size);
+	if (ck == NULL || ck->size - ck->used < size) {
+		sz = (size > arena->sz_chunk ? size : arena->sz_chunk);
+		ck = (XMLArenaChunk*)__malloc(ARENA_ALIGN(sizeof(XMLArenaChunk)) + sz);
+		if (ck == NULL)
+			return NULL;
+		ck->size = sz;
+		ck->used = 0;
+		if (arena->chunks != NULL && sz > arena->sz_chunk) {
+			ck->next = arena->chunks->next;
+			arena->chunks->next = ck;
+		} else {
+			ck->next = arena->chunks;
+			arena->chunks = ck;
+		}
+	}
+	ck->used += size;
+
+	return ARENA_DATA(ck) + ck->used - size;
+}
+
+/*
+ Copy 'str' in 'arena'.
+ Return NULL for memory error.
+ */
+static SXML_CHAR* _arena_strdup(XMLArena* arena, const SXML_CHAR* str)
+{
+	size_t sz = (sx_strlen(str) + 1) * sizeof(SXML_CHAR);
+	SXML_CHAR* p = (SXML_CHAR*)_arena_alloc(arena, sz);
+
+	if (p != NULL)
+		memcpy(p, str, sz);
+
+	return p;
+}
+
+static void _arena_free(XMLArena* arena)
+{
+	XMLArenaChunk* ck;
+
+	while ((ck = arena->chunks) != NULL) {
+		arena->chunks = ck->next;
+		__free(ck);
+	}
+}
+
 /* --- XMLNode methods --- */
 
 /*
- Add 'node' to given '*children_array' of '*len_array' elements.
+ Make 'array' of '*sz_array' elements of 'sz_elem' bytes hold at least 'n' elements. It grows
+ geometrically so that adding elements one by one is amortized.
+ Return the reallocated array (or 'array' if it is large enough), or NULL for memory error, in
+ which case 'array' is left untouched.
+ */
+static void* _grow_array(void* array, int* sz_array, int n, size_t sz_elem)
+{
+	void* pt;
+	int sz;
+
+	if (array != NULL && n <= *sz_array)
+		return array;
+
+	sz = (*sz_array > 0 ? 2 * *sz_array : 4);
+	if (sz < n)
+		sz = n;
+	pt = __realloc(array, sz * sz_elem);
+	if (pt != NULL)
+		*sz_array = sz;
+
+	return pt;
+}
+
+/*
+ Add 'node' to given '*children_array' of '*len_array' elements, its allocated size being '*sz_array'.
  '*len_array' is overwritten with the number of elements in '*children_array' after its reallocation.
  Return the index of the newly added 'node' in '*children_array', or '-1' for memory error.
  */
-static int _add_node(XMLNode*** children_array, int* len_array, XMLNode* node)
+static int _add_node(XMLNode*** children_array, int* len_array, int* sz_array, XMLNode* node)
 {
-	XMLNode** pt = (XMLNode**)__realloc(*children_array, (*len_array+1) * sizeof(XMLNode*));
+	XMLNode** pt = (XMLNode**)_grow_array(*children_array, sz_array, *len_array + 1, sizeof(XMLNode*));
 	
 	if (pt == NULL)
 		return -1;
@@ -173,6 +374,78 @@ static int _add_node(XMLNode*** children_array, int* len_array, XMLNode* node)
 	return (*len_array)++;
 }
 
+/*
+ Append 'text' to 'node' text, which grows geometrically when it is appended to again.
+ Return 'false' for memory error.
+ */
+static int _XMLNode_append_text(XMLNode* node, const SXML_CHAR* text)
+{
+	size_t len = (node->text == NULL ? 0 : node->len_text);
+	size_t len_add = sx_strlen(text);
+	size_t n = len + len_add + 1;
+	size_t sz = (len > 0 && 2 * len > n ? 2 * len : n);
+	SXML_CHAR* p;
+
+	if (node->text == NULL || (node->borrowed & XML_BORROWED_TEXT)) { /* Borrowed text cannot be reallocated */
+		if ((p = (SXML_CHAR*)__malloc(sz * sizeof(SXML_CHAR))) == NULL)
+			return false;
+		if (len > 0)
+			memcpy(p, node->text, len * sizeof(SXML_CHAR));
+		node->sz_text = sz;
+	} else if (n > node->sz_text) {
+		if ((p = (SXML_CHAR*)__realloc(node->text, sz * sizeof(SXML_CHAR))) == NULL)
+			return false;
+		node->sz_text = sz;
+	} else
+		p = node->text;
+	memcpy(&p[len], text, (len_add + 1) * sizeof(SXML_CHAR));
+	node->text = p;
+	node->len_text = len + len_add;
+	node->borrowed &= ~XML_BORROWED_TEXT;
+
+	return true;
+}
+
+/*
+ Have 'node' own its attribute names and values by duplicating them if they were borrowed.
+ Return 'false' for memory error, in which case 'node' is left untouched.
+ */
+static int _XMLNode_own_attributes(XMLNode* node)
+{
+	XMLAttribute* pt;
+	int i;
+
+	if (!(node->borrowed & XML_BORROWED_ATTRIBUTES))
+		return true;
+
+	pt = (XMLAttribute*)__calloc(node->n_attributes > 0 ? node->n_attributes : 1, sizeof(XMLAttribute));
+	if (pt == NULL)
+		return false;
+	for (i = 0; i < node->n_attributes; i++) {
+		pt[i].name = sx_strdup(node->attributes[i].name);
+		pt[i].value = (node->attributes[i].value == NULL ? NULL : sx_strdup(node->attributes[i].value));
+		pt[i].active = node->attributes[i].active;
+		if (pt[i].name == NULL || (pt[i].value == NULL && node->attributes[i].value != NULL))
+			break;
+	}
+	if (i < node->n_attributes) {
+		for (; i >= 0; i--) {
+			if (pt[i].name != NULL) __free(pt[i].name);
+			if (pt[i].value != NULL) __free(pt[i].value);
+		}
+		__free(pt);
+		return false;
+	}
+
+	if (node->attributes != NULL)
+		__free(node->attributes);
+	node->attributes = pt;
+	node->sz_attributes = (node->n_attributes > 0 ? node->n_attributes : 1);
+	node->borrowed &= ~(XML_BORROWED_ATTRIBUTES | XML_PACKED_ATTRIBUTES);
+
+	return true;
+}
+
 int XMLNode_init(XMLNode* node)
 {
 	if (node == NULL)
@@ -183,16 +456,22 @@ int XMLNode_init(XMLNode* node)
 
 	node->tag = NULL;
 	node->text = NULL;
+	node->len_text = 0;
+	node->sz_text = 0;
 	
 	node->attributes = NULL;
 	node->n_attributes = 0;
+	node->sz_attributes = 0;
 	
 	node->father = NULL;
+	node->i_child = -1;
 	node->children = NULL;
 	node->n_children = 0;
+	node->sz_children = 0;
 	
 	node->tag_type = TAG_NONE;
 	node->active = true;
+	node->borrowed = 0;
 
 	node->init_value = XML_INIT_DONE;
 
@@ -244,7 +523,8 @@ int XMLNode_free(XMLNode* node)
 		return false;
 	
 	if (node->tag != NULL) {
-		__free(node->tag);
+		if (!(node->borrowed & XML_BORROWED_TAG))
+			__free(node->tag);
 		node->tag = NULL;
 	}
 
@@ -253,6 +533,18 @@ int XMLNode_free(XMLNode* node)
 	XMLNode_remove_children(node);
 	
 	node->tag_type = TAG_NONE;
+	node->borrowed &= XML_BORROWED_NODE; /* The node itself still belongs to its arena */
+
+	return true;
+}
+
+int XMLNode_delete(XMLNode* node)
+{
+	if (!XMLNode_free(node))
+		return false;
+
+	if (!(node->borrowed & XML_BORROWED_NODE))
+		__free(node);
 
 	return true;
 }
@@ -280,13 +572,15 @@ int XMLNode_copy(XMLNode* dst, const XMLNode* src, int copy_children)
 	if (src->text != NULL) {
 		dst->text = sx_strdup(src->text);
 		if (dst->text == NULL) goto copy_err;
+		dst->len_text = sx_strlen(dst->text);
+		dst->sz_text = dst->len_text + 1;
 	}
 
 	/* Attributes */
 	if (src->n_attributes > 0) {
 		dst->attributes = (XMLAttribute*)__calloc(src->n_attributes, sizeof(XMLAttribute));
 		if (dst->attributes== NULL) goto copy_err;
-		dst->n_attributes = src->n_attributes;
+		dst->n_attributes = dst->sz_attributes = src->n_attributes;
 		for (i = 0; i < src->n_attributes; i++) {
 			dst->attributes[i].name = sx_strdup(src->attributes[i].name);
 			dst->attributes[i].value = sx_strdup(src->attributes[i].value);
@@ -297,6 +591,7 @@ int XMLNode_copy(XMLNode* dst, const XMLNode* src, int copy_children)
 
 	dst->tag_type = src->tag_type;
 	dst->father = src->father;
+	dst->i_child = src->i_child;
 	dst->user = src->user;
 	dst->active = src->active;
 	
@@ -304,10 +599,11 @@ int XMLNode_copy(XMLNode* dst, const XMLNode* src, int copy_children)
 	if (copy_children && src->n_children > 0) {
 		dst->children = (XMLNode**)__calloc(src->n_children, sizeof(XMLNode*));
 		if (dst->children == NULL) goto copy_err;
-		dst->n_children = src->n_children;
+		dst->n_children = dst->sz_children = src->n_children;
 		for (i = 0; i < src->n_children; i++) {
 			dst->children[i] = XMLNode_allocN(1);
 			if (!XMLNode_copy(dst->children[i], src->children[i], true)) goto copy_err;
+			dst->children[i]->father = dst;
 		}
 	}
 	
@@ -335,11 +631,15 @@ int XMLNode_set_tag(XMLNode* node, const SXML_CHAR* tag)
 	if (node == NULL || tag == NULL || node->init_value != XML_INIT_DONE)
 		return false;
 	
+	/* Attribute strings packed with the tag should not be freed with it */
+	if ((node->borrowed & XML_PACKED_ATTRIBUTES) && !_XMLNode_own_attributes(node))
+		return false;
 	newtag = sx_strdup(tag);
 	if (newtag == NULL)
 		return false;
-	if (node->tag != NULL) __free(node->tag);
+	if (node->tag != NULL && !(node->borrowed & XML_BORROWED_TAG)) __free(node->tag);
 	node->tag = newtag;
+	node->borrowed &= ~XML_BORROWED_TAG;
 
 	return true;
 }
@@ -370,6 +670,9 @@ int XMLNode_set_attribute(XMLNode* node, const SXML_CHAR* attr_name, const SXML_
 	if (node == NULL || attr_name == NULL || attr_name[0] == NULC || node->init_value != XML_INIT_DONE)
 		return -1;
 	
+	if (!_XMLNode_own_attributes(node))
+		return -1;
+
 	i = XMLNode_search_attribute(node, attr_name, 0);
 	if (i >= 0) { /* Attribute found: update it */
 		SXML_CHAR* value = NULL;
@@ -390,7 +693,7 @@ int XMLNode_set_attribute(XMLNode* node, const SXML_CHAR* attr_name, const SXML_
  			return -1;
 		}
 		i = node->n_attributes;
-		pt = (XMLAttribute*)__realloc(node->attributes, (i+1) * sizeof(XMLAttribute));
+		pt = (XMLAttribute*)_grow_array(node->attributes, &node->sz_attributes, i + 1, sizeof(XMLAttribute));
 		if (pt == NULL) {
 			if (value != NULL)
 				__free(value);
@@ -464,30 +767,16 @@ int XMLNode_search_attribute(const XMLNode* node, const SXML_CHAR* attr_name, in
 
 int XMLNode_remove_attribute(XMLNode* node, int i_attr)
 {
-	XMLAttribute* pt;
 	if (node == NULL || node->init_value != XML_INIT_DONE || i_attr < 0 || i_attr >= node->n_attributes)
 		return -1;
 	
-	/* Before modifying first see if we run out of memory */
-	if (node->n_attributes == 1)
-		pt = NULL;
-	else {
-		pt = (XMLAttribute*)__malloc((node->n_attributes - 1) * sizeof(XMLAttribute));
-		if (pt == NULL)
-			return -1;
+	if (!(node->borrowed & XML_BORROWED_ATTRIBUTES)) {
+		if (node->attributes[i_attr].name != NULL) __free(node->attributes[i_attr].name);
+		if (node->attributes[i_attr].value != NULL) __free(node->attributes[i_attr].value);
 	}
-
-	/* Can't fail anymore, free item */
-	if (node->attributes[i_attr].name != NULL) __free(node->attributes[i_attr].name);
-	if (node->attributes[i_attr].value != NULL) __free(node->attributes[i_attr].value);
 	
-	if (pt != NULL) {
-		memcpy(pt, node->attributes, i_attr * sizeof(XMLAttribute));
-		memcpy(&pt[i_attr], &node->attributes[i_attr + 1], (node->n_attributes - i_attr - 1) * sizeof(XMLAttribute));
-	}
-	if (node->attributes != NULL)
-		__free(node->attributes);
-	node->attributes = pt;
+	/* The array keeps its allocated size */
+	memmove(&node->attributes[i_attr], &node->attributes[i_attr + 1], (node->n_attributes - i_attr - 1) * sizeof(XMLAttribute));
 	node->n_attributes--;
 	
 	return node->n_attributes;
@@ -501,7 +790,7 @@ int XMLNode_remove_all_attributes(XMLNode* node)
 		return false;
 
 	if (node->attributes != NULL) {
-		for (i = 0; i < node->n_attributes; i++) {
+		for (i = 0; i < node->n_attributes && !(node->borrowed & XML_BORROWED_ATTRIBUTES); i++) {
 			if (node->attributes[i].name != NULL)
 				__free(node->attributes[i].name);
 			if (node->attributes[i].value != NULL)
@@ -511,6 +800,27 @@ int XMLNode_remove_all_attributes(XMLNode* node)
 		node->attributes = NULL;
 	}
 	node->n_attributes = 0;
+	node->sz_attributes = 0;
+	node->borrowed &= ~(XML_BORROWED_ATTRIBUTES | XML_PACKED_ATTRIBUTES);
+
+	return true;
+}
+
+int XMLNode_reserve_attributes(XMLNode* node, int n)
+{
+	XMLAttribute* pt;
+
+	if (node == NULL || node->init_value != XML_INIT_DONE || n < 0)
+		return false;
+
+	if (n <= node->sz_attributes && (node->attributes != NULL || n == 0))
+		return true;
+
+	pt = (XMLAttribute*)__realloc(node->attributes, n * sizeof(XMLAttribute));
+	if (pt == NULL)
+		return false;
+	node->attributes = pt;
+	node->sz_attributes = n;
 
 	return true;
 }
@@ -518,22 +828,32 @@ int XMLNode_remove_all_attributes(XMLNode* node)
 int XMLNode_set_text(XMLNode* node, const SXML_CHAR* text)
 {
 	SXML_CHAR* p;
+	size_t len;
 	if (node == NULL || node->init_value != XML_INIT_DONE)
 		return false;
 
 	if (text == NULL) { /* We want to remove it => free node text */
 		if (node->text != NULL) {
-			__free(node->text);
+			if (!(node->borrowed & XML_BORROWED_TEXT))
+				__free(node->text);
 			node->text = NULL;
 		}
+		node->len_text = 0;
+		node->sz_text = 0;
+		node->borrowed &= ~XML_BORROWED_TEXT;
 
 		return true;
 	}
 
-	p = (SXML_CHAR*)__realloc(node->text, (sx_strlen(text) + 1)*sizeof(SXML_CHAR)); /* +1 for '\0' */
+	/* Borrowed text cannot be reallocated */
+	len = sx_strlen(text);
+	p = (SXML_CHAR*)__realloc(node->borrowed & XML_BORROWED_TEXT ? NULL : node->text, (len + 1)*sizeof(SXML_CHAR)); /* +1 for '\0' */
 	if (p == NULL)
 		return false;
 	node->text = p;
+	node->len_text = len;
+	node->sz_text = len + 1;
+	node->borrowed &= ~XML_BORROWED_TEXT;
 
 	sx_strcpy(node->text, text);
 
@@ -542,12 +862,15 @@ int XMLNode_set_text(XMLNode* node, const SXML_CHAR* text)
 
 int XMLNode_add_child(XMLNode* node, XMLNode* child)
 {
+	int i;
+
 	if (node == NULL || child == NULL || node->init_value != XML_INIT_DONE || child->init_value != XML_INIT_DONE)
 		return false;
 	
-	if (_add_node(&node->children, &node->n_children, child) >= 0) {
+	if ((i = _add_node(&node->children, &node->n_children, &node->sz_children, child)) >= 0) {
 		node->tag_type = TAG_FATHER;
 		child->father = node;
+		child->i_child = i;
 		return true;
 	} else
 		return false;
@@ -586,7 +909,6 @@ XMLNode* XMLNode_get_child(const XMLNode* node, int i_child)
 int XMLNode_remove_child(XMLNode* node, int i_child, int free_child)
 {
 	int i;
-	XMLNode** pt;
 
 	if (node == NULL || node->init_value != XML_INIT_DONE || i_child < 0 || i_child >= node->n_children)
 		return -1;
@@ -601,28 +923,16 @@ int XMLNode_remove_child(XMLNode* node, int i_child, int free_child)
 	if (i >= node->n_children)
 		return -1; /* Children is not found */
 
-	/* Before modifying first see if we run out of memory */
-	if (node->n_children == 1)
-		pt = NULL;
-	else {
-		pt = (XMLNode**)__malloc((node->n_children - 1) * sizeof(XMLNode*));
-		if (pt == NULL)
-			return -1;
-	}
-
-	/* Can't fail anymore, free item */
-	(void)XMLNode_free(node->children[i_child]);
 	if (free_child)
-		__free(node->children[i_child]);
+		(void)XMLNode_delete(node->children[i_child]);
+	else
+		(void)XMLNode_free(node->children[i_child]);
 	
-	if (pt != NULL) {
-		memcpy(pt, node->children, i_child * sizeof(XMLNode*));
-		memcpy(&pt[i_child], &node->children[i_child + 1], (node->n_children - i_child - 1) * sizeof(XMLNode*));
-	}
-	if (node->children != NULL)
-		__free(node->children);
-	node->children = pt;
+	/* The array keeps its allocated size */
+	memmove(&node->children[i_child], &node->children[i_child + 1], (node->n_children - i_child - 1) * sizeof(XMLNode*));
 	node->n_children--;
+	for (i = i_child; i < node->n_children; i++)
+		node->children[i]->i_child = i;
 	if (node->n_children == 0)
 		node->tag_type = TAG_SELF;
 	
@@ -638,18 +948,36 @@ int XMLNode_remove_children(XMLNode* node)
 
 	if (node->children != NULL) {
 		for (i = 0; i < node->n_children; i++)
-			if (node->children[i] != NULL) {
-				(void)XMLNode_free(node->children[i]);
-				__free(node->children[i]);
-			}
+			if (node->children[i] != NULL)
+				(void)XMLNode_delete(node->children[i]);
 		__free(node->children);
 		node->children = NULL;
 	}
 	node->n_children = 0;
+	node->sz_children = 0;
 	
 	return true;
 }
 
+int XMLNode_reserve_children(XMLNode* node, int n)
+{
+	XMLNode** pt;
+
+	if (node == NULL || node->init_value != XML_INIT_DONE || n < 0)
+		return false;
+
+	if (n <= node->sz_children && (node->children != NULL || n == 0))
+		return true;
+
+	pt = (XMLNode**)__realloc(node->children, n * sizeof(XMLNode*));
+	if (pt == NULL)
+		return false;
+	node->children = pt;
+	node->sz_children = n;
+
+	return true;
+}
+
 int XMLNode_equal(const XMLNode* node1, const XMLNode* node2)
 {
 	int i, j;
@@ -688,19 +1016,48 @@ int XMLNode_equal(const XMLNode* node1, const XMLNode* node2)
 	return true;
 }
 
+/*
+ Return the index of 'node' in its father children, or -1 if it cannot be found.
+ 'node->i_child' is checked first so that children arrays modified directly are still handled.
+ */
+static int _XMLNode_index(const XMLNode* node)
+{
+	XMLNode* father = node->father;
+	int i;
+
+	i = node->i_child;
+	if (i >= 0 && i < father->n_children && father->children[i] == node)
+		return i;
+
+	for (i = 0; i < father->n_children && father->children[i] != node; i++) ;
+
+	return i < father->n_children ? i : -1;
+}
+
 XMLNode* XMLNode_next_sibling(const XMLNode* node)
 {
 	int i;
-	XMLNode* father;
 
 	if (node == NULL || node->init_value != XML_INIT_DONE || node->father == NULL)
 		return NULL;
 
-	father = node->father;
-	for (i = 0; i < father->n_children && father->children[i] != node; i++) ;
+	if ((i = _XMLNode_index(node)) < 0)
+		return NULL;
 	i++; /* father->children[i] is now 'node' next sibling */
 
-	return i < father->n_children ? father->children[i] : NULL;
+	return i < node->father->n_children ? node->father->children[i] : NULL;
+}
+
+XMLNode* XMLNode_prev_sibling(const XMLNode* node)
+{
+	int i;
+
+	if (node == NULL || node->init_value != XML_INIT_DONE || node->father == NULL)
+		return NULL;
+
+	i = _XMLNode_index(node);
+
+	return i > 0 ? node->father->children[i - 1] : NULL;
 }
 
 static XMLNode* _XMLNode_next(const XMLNode* node, int in_children)
@@ -740,12 +1097,25 @@ int XMLDoc_init(XMLDoc* doc)
 #endif
 	doc->nodes = NULL;
 	doc->n_nodes = 0;
+	doc->sz_nodes = 0;
 	doc->i_root = -1;
+	doc->arena.chunks = NULL;
+	doc->arena.sz_chunk = 0;
 	doc->init_value = XML_INIT_DONE;
 
 	return true;
 }
 
+int XMLDoc_init_arena(XMLDoc* doc, size_t sz_chunk)
+{
+	if (!XMLDoc_init(doc))
+		return false;
+
+	doc->arena.sz_chunk = (sz_chunk > 0 ? sz_chunk : XML_ARENA_CHUNK);
+
+	return true;
+}
+
 int XMLDoc_free(XMLDoc* doc)
 {
 	int i;
@@ -753,14 +1123,14 @@ int XMLDoc_free(XMLDoc* doc)
 	if (doc == NULL || doc->init_value != XML_INIT_DONE)
 		return false;
 
-	for (i = 0; i < doc->n_nodes; i++) {
-		(void)XMLNode_free(doc->nodes[i]);
-		__free(doc->nodes[i]);
-	}
+	for (i = 0; i < doc->n_nodes; i++)
+		(void)XMLNode_delete(doc->nodes[i]);
 	__free(doc->nodes);
 	doc->nodes = NULL;
 	doc->n_nodes = 0;
+	doc->sz_nodes = 0;
 	doc->i_root = -1;
+	_arena_free(&doc->arena);
 
 	return true;
 }
@@ -780,7 +1150,7 @@ int XMLDoc_add_node(XMLDoc* doc, XMLNode* node)
 	if (doc == NULL || node == NULL || doc->init_value != XML_INIT_DONE)
 		return -1;
 	
-	if (_add_node(&doc->nodes, &doc->n_nodes, node) < 0)
+	if (_add_node(&doc->nodes, &doc->n_nodes, &doc->sz_nodes, node) < 0)
 		return -1;
 
 	if (node->tag_type == TAG_FATHER)
@@ -791,32 +1161,70 @@ int XMLDoc_add_node(XMLDoc* doc, XMLNode* node)
 
 int XMLDoc_remove_node(XMLDoc* doc, int i_node, int free_node)
 {
-	XMLNode** pt;
-	if (doc == NULL || doc->init_value != XML_INIT_DONE || i_node < 0 || i_node > doc->n_nodes)
+	if (doc == NULL || doc->init_value != XML_INIT_DONE || i_node < 0 || i_node >= doc->n_nodes)
 		return false;
 
-	/* Before modifying first see if we run out of memory */
-	if (doc->n_nodes == 1)
-		pt = NULL;
-	else {
-		pt = (XMLNode**)__malloc((doc->n_nodes - 1) * sizeof(XMLNode*));
-		if (pt == NULL)
-			return false;
+	if (free_node)
+		(void)XMLNode_delete(doc->nodes[i_node]);
+	else
+		(void)XMLNode_free(doc->nodes[i_node]);
+	
+	/* The array keeps its allocated size */
+	memmove(&doc->nodes[i_node], &doc->nodes[i_node + 1], (doc->n_nodes - i_node - 1) * sizeof(XMLNode*));
+	doc->n_nodes--;
+
+	return true;
+}
+
+/*
+ Reallocate '*array' of 'sz_elem' bytes elements to its 'n' elements, freeing it when 'n' is 0.
+ '*array' is kept when it cannot be reallocated.
+ */
+static void _shrink_array(void** array, int* sz_array, int n, size_t sz_elem)
+{
+	void* pt;
+
+	if (*array == NULL || *sz_array == n)
+		return;
+	if (n == 0) {
+		__free(*array);
+		*array = NULL;
+		*sz_array = 0;
+	} else if ((pt = __realloc(*array, n * sz_elem)) != NULL) {
+		*array = pt;
+		*sz_array = n;
 	}
+}
 
-	/* Can't fail anymore, free item */
-	(void)XMLNode_free(doc->nodes[i_node]);
-	if (free_node) __free(doc->nodes[i_node]);
-	
-	if (pt != NULL) {
-		memcpy(pt, &doc->nodes[i_node], i_node * sizeof(XMLNode*));
-		memcpy(&pt[i_node], &doc->nodes[i_node + 1], (doc->n_nodes - i_node - 1) * sizeof(XMLNode*));
+static void _XMLNode_shrink_to_fit(XMLNode* node)
+{
+	SXML_CHAR* p;
+	size_t len;
+	int i;
+
+	if (node->text != NULL && !(node->borrowed & XML_BORROWED_TEXT)) {
+		len = node->len_text + 1;
+		if (node->sz_text != len && (p = (SXML_CHAR*)__realloc(node->text, len * sizeof(SXML_CHAR))) != NULL) {
+			node->text = p;
+			node->sz_text = len;
+		}
 	}
+	_shrink_array((void**)&node->attributes, &node->sz_attributes, node->n_attributes, sizeof(XMLAttribute));
+	_shrink_array((void**)&node->children, &node->sz_children, node->n_children, sizeof(XMLNode*));
+	for (i = 0; i < node->n_children; i++)
+		_XMLNode_shrink_to_fit(node->children[i]);
+}
 
-	if (doc->nodes != NULL)
-		__free(doc->nodes);
-	doc->nodes = pt;
-	doc->n_nodes--;
+int XMLDoc_shrink_to_fit(XMLDoc* doc)
+{
+	int i;
+
+	if (doc == NULL || doc->init_value != XML_INIT_DONE)
+		return false;
+
+	_shrink_array((void**)&doc->nodes, &doc->sz_nodes, doc->n_nodes, sizeof(XMLNode*));
+	for (i = 0; i < doc->n_nodes; i++)
+		_XMLNode_shrink_to_fit(doc->nodes[i]);
 
 	return true;
 }
@@ -854,7 +1262,7 @@ static int _print_formatting(const XMLNode* node, FILE* f, const SXML_CHAR* tag_
 	return cur_sz_line;
 }
 
-static int _XMLNode_print_header(const XMLNode* node, FILE* f, const SXML_CHAR* tag_sep, const SXML_CHAR* child_sep, const SXML_CHAR* attr_sep, int sz_line, int cur_sz_line, int nb_char_tab)
+static int _XMLNode_print_header(const XMLNode* node, FILE* f, const SXML_CHAR* tag_sep, const SXML_CHAR* child_sep, const SXML_CHAR* attr_sep, int sz_line, int cur_sz_line, int nb_char_tab, const XMLContext* ctx)
 {
 	int i;
 	SXML_CHAR* p;
@@ -880,10 +1288,10 @@ static int _XMLNode_print_header(const XMLNode* node, FILE* f, const SXML_CHAR*
 	}
 
 	/* Check for user tags */
-	for (i = 0; i < _user_tags.n_tags; i++) {
-		if (node->tag_type == _user_tags.tags[i].tag_type) {
-			sx_fprintf(f, C2SX("%s%s%s"), _user_tags.tags[i].start, node->tag, _user_tags.tags[i].end);
-			cur_sz_line += sx_strlen(_user_tags.tags[i].start) + sx_strlen(node->tag) + sx_strlen(_user_tags.tags[i].end);
+	for (i = 0; i < ctx->n_user_tags; i++) {
+		if (node->tag_type == ctx->user_tags[i].tag_type) {
+			sx_fprintf(f, C2SX("%s%s%s"), ctx->user_tags[i].start, node->tag, ctx->user_tags[i].end);
+			cur_sz_line += sx_strlen(ctx->user_tags[i].start) + sx_strlen(node->tag) + sx_strlen(ctx->user_tags[i].end);
 			return cur_sz_line;
 		}
 	}
@@ -931,10 +1339,10 @@ static int _XMLNode_print_header(const XMLNode* node, FILE* f, const SXML_CHAR*
 
 int XMLNode_print_header(const XMLNode* node, FILE* f, int sz_line, int nb_char_tab)
 {
-	return _XMLNode_print_header(node, f, NULL, NULL, NULL, sz_line, 0, nb_char_tab) < 0 ? false : true;
+	return _XMLNode_print_header(node, f, NULL, NULL, NULL, sz_line, 0, nb_char_tab, &_default_ctx) < 0 ? false : true;
 }
 
-static int _XMLNode_print(const XMLNode* node, FILE* f, const SXML_CHAR* tag_sep, const SXML_CHAR* child_sep, const SXML_CHAR* attr_sep, int keep_text_spaces, int sz_line, int cur_sz_line, int nb_char_tab, int depth)
+static int _XMLNode_print(const XMLNode* node, FILE* f, const SXML_CHAR* tag_sep, const SXML_CHAR* child_sep, const SXML_CHAR* attr_sep, int keep_text_spaces, int sz_line, int cur_sz_line, int nb_char_tab, int depth, const XMLContext* ctx)
 {
 	int i;
 	SXML_CHAR* p;
@@ -961,7 +1369,7 @@ static int _XMLNode_print(const XMLNode* node, FILE* f, const SXML_CHAR* tag_sep
 	else
 		cur_sz_line = _print_formatting(node, f, tag_sep, child_sep, nb_char_tab, cur_sz_line);
 	
-	_XMLNode_print_header(node, f, tag_sep, child_sep, attr_sep, sz_line, cur_sz_line, nb_char_tab);
+	_XMLNode_print_header(node, f, tag_sep, child_sep, attr_sep, sz_line, cur_sz_line, nb_char_tab, ctx);
 
 	if (node->text != NULL && node->text[0] != NULC) {
 		/* Text has to be printed: check if it is only spaces */
@@ -975,7 +1383,7 @@ static int _XMLNode_print(const XMLNode* node, FILE* f, const SXML_CHAR* tag_sep
 	
 	/* Recursively print children */
 	for (i = 0; i < node->n_children; i++)
-		(void)_XMLNode_print(node->children[i], f, tag_sep, child_sep, attr_sep, keep_text_spaces, sz_line, cur_sz_line, nb_char_tab, depth+1);
+		(void)_XMLNode_print(node->children[i], f, tag_sep, child_sep, attr_sep, keep_text_spaces, sz_line, cur_sz_line, nb_char_tab, depth+1, ctx);
 	
 	/* Print tag end after children */
 		/* Print formatting */
@@ -988,15 +1396,28 @@ static int _XMLNode_print(const XMLNode* node, FILE* f, const SXML_CHAR* tag_sep
 
 int XMLNode_print_attr_sep(const XMLNode* node, FILE* f, const SXML_CHAR* tag_sep, const SXML_CHAR* child_sep, const SXML_CHAR* attr_sep, int keep_text_spaces, int sz_line, int nb_char_tab)
 {
-	return _XMLNode_print(node, f, tag_sep, child_sep, attr_sep, keep_text_spaces, sz_line, 0, nb_char_tab, 0);
+	return XMLNode_print_ctx(node, f, tag_sep, child_sep, attr_sep, keep_text_spaces, sz_line, nb_char_tab, NULL);
+}
+
+int XMLNode_print_ctx(const XMLNode* node, FILE* f, const SXML_CHAR* tag_sep, const SXML_CHAR* child_sep, const SXML_CHAR* attr_sep, int keep_text_spaces, int sz_line, int nb_char_tab, const XMLContext* ctx)
+{
+	return _XMLNode_print(node, f, tag_sep, child_sep, attr_sep, keep_text_spaces, sz_line, 0, nb_char_tab, 0, ctx != NULL ? ctx : &_default_ctx);
 }
 
 int XMLDoc_print_attr_sep(const XMLDoc* doc, FILE* f, const SXML_CHAR* tag_sep, const SXML_CHAR* child_sep, const SXML_CHAR* attr_sep, int keep_text_spaces, int sz_line, int nb_char_tab)
+{
+	return XMLDoc_print_ctx(doc, f, tag_sep, child_sep, attr_sep, keep_text_spaces, sz_line, nb_char_tab, NULL);
+}
+
+int XMLDoc_print_ctx(const XMLDoc* doc, FILE* f, const SXML_CHAR* tag_sep, const SXML_CHAR* child_sep, const SXML_CHAR* attr_sep, int keep_text_spaces, int sz_line, int nb_char_tab, const XMLContext* ctx)
 {
 	int i, depth, cur_sz_line;
 	
 	if (doc == NULL || f == NULL || doc->init_value != XML_INIT_DONE)
 		return false;
+
+	if (ctx == NULL)
+		ctx = &_default_ctx;
 	
 #ifdef SXMLC_UNICODE
 	/* Write BOM if it exist */
@@ -1005,7 +1426,7 @@ int XMLDoc_print_attr_sep(const XMLDoc* doc, FILE* f, const SXML_CHAR* tag_sep,
 
 	depth = -1; /* UGLY HACK: 'depth' forced negative on very first line so we don't print an extra 'tag_sep' (usually "\n") */
 	for (i = 0, cur_sz_line = 0; i < doc->n_nodes; i++) {
-		cur_sz_line = _XMLNode_print(doc->nodes[i], f, tag_sep, child_sep, attr_sep, keep_text_spaces, sz_line, cur_sz_line, nb_char_tab, depth);
+		cur_sz_line = _XMLNode_print(doc->nodes[i], f, tag_sep, child_sep, attr_sep, keep_text_spaces, sz_line, cur_sz_line, nb_char_tab, depth, ctx);
 		depth = 0;
 	}
 	/* TODO: Find something more graceful than 'depth=-1', even though everyone knows I probably never will ;) */
@@ -1030,11 +1451,11 @@ int XML_parse_attribute_to(const SXML_CHAR* str, int to, XMLAttribute* xmlattr)
 	
 	/* Search for the '=' */
 	/* 'n0' is where the attribute name stops, 'n1' is where the attribute value starts */
-	for (n0 = 0; n0 != to && str[n0] != C2SX('=') && !sx_isspace(str[n0]); n0++) ; /* Search for '=' or a space */
-	for (n1 = n0; n1 != to && sx_isspace(str[n1]); n1++) ; /* Search for something not a space */
+	for (n0 = 0; n0 != to && str[n0] != C2SX('=') && !isxmlspace(str[n0]); n0++) ; /* Search for '=' or a space */
+	for (n1 = n0; n1 != to && isxmlspace(str[n1]); n1++) ; /* Search for something not a space */
 	if (str[n1] != C2SX('='))
 		return 0; /* '=' not found: malformed string */
-	for (n1++; n1 != to && sx_isspace(str[n1]); n1++) ; /* Search for something not a space */
+	for (n1++; n1 != to && isxmlspace(str[n1]); n1++) ; /* Search for something not a space */
 	if (isquote(str[n1])) { /* Remove quotes */
 		quote = str[n1];
 		remQ = 1;
@@ -1110,7 +1531,7 @@ TagType XML_parse_1string(const SXML_CHAR* str, XMLNode* xmlnode)
 	if (str[0] != C2SX('<') || str[len-1] != C2SX('>'))
 		return TAG_ERROR;
 
-	for (nn = 0; nn < NB_SPECIAL_TAGS; nn++) {
+	for (nn = 0; nn < NB_SPECIAL_TAGS && IS_SPECIAL_TAG_CHAR(str[1]); nn++) {
 		n = (int)_parse_special_tag(str, len, &_spec[nn], xmlnode);
 		switch (n) {
 			case TAG_NONE:	break;				/* Nothing found => do nothing */
@@ -1141,8 +1562,8 @@ TagType XML_parse_1string(const SXML_CHAR* str, XMLNode* xmlnode)
 	}
 	
 	/* Test user tags */
-	for (nn = 0; nn < _user_tags.n_tags; nn++) {
-		n = _parse_special_tag(str, len, &_user_tags.tags[nn], xmlnode);
+	for (nn = 0; nn < _default_ctx.n_user_tags && IS_USER_TAG_CHAR(&_default_ctx, str[1]); nn++) {
+		n = _parse_special_tag(str, len, &_default_ctx.user_tags[nn], xmlnode);
 		switch (n) {
 			case TAG_ERROR:	return TAG_NONE;	/* Error => exit */
 			case TAG_NONE:	break;				/* Nothing found => do nothing */
@@ -1154,7 +1575,7 @@ TagType XML_parse_1string(const SXML_CHAR* str, XMLNode* xmlnode)
 		tag_end = 1;
 	
 	/* tag starts at index 1 (or 2 if tag end) and ends at the first space or '/>' */
-	for (n = 1 + tag_end; str[n] != NULC && str[n] != C2SX('>') && str[n] != C2SX('/') && !sx_isspace(str[n]); n++) ;
+	for (n = 1 + tag_end; str[n] != NULC && str[n] != C2SX('>') && str[n] != C2SX('/') && !isxmlspace(str[n]); n++) ;
 	xmlnode->tag = (SXML_CHAR*)__malloc((n - tag_end)*sizeof(SXML_CHAR));
 	if (xmlnode->tag == NULL)
 		return TAG_ERROR;
@@ -1168,7 +1589,7 @@ TagType XML_parse_1string(const SXML_CHAR* str, XMLNode* xmlnode)
 	/* Here, 'n' is the position of the first space after tag name */
 	while (n < len) {
 		/* Skips spaces */
-		while (sx_isspace(str[n])) n++;
+		while (isxmlspace(str[n])) n++;
 		
 		/* Check for XML end ('>' or '/>') */
 		if (str[n] == C2SX('>')) { /* Tag with children */
@@ -1184,7 +1605,7 @@ TagType XML_parse_1string(const SXML_CHAR* str, XMLNode* xmlnode)
 		/* New attribute found */
 		p = sx_strchr(str+n, C2SX('='));
 		if (p == NULL) goto parse_err;
-		pt = (XMLAttribute*)__realloc(xmlnode->attributes, (xmlnode->n_attributes + 1) * sizeof(XMLAttribute));
+		pt = (XMLAttribute*)_grow_array(xmlnode->attributes, &xmlnode->sz_attributes, xmlnode->n_attributes + 1, sizeof(XMLAttribute));
 		if (pt == NULL) goto parse_err;
 		
 		pt[xmlnode->n_attributes].name = NULL;
@@ -1192,13 +1613,13 @@ TagType XML_parse_1string(const SXML_CHAR* str, XMLNode* xmlnode)
 		pt[xmlnode->n_attributes].active = false;
 		xmlnode->n_attributes++;
 		xmlnode->attributes = pt;
-		while (*p != NULC && sx_isspace(*++p)) ; /* Skip spaces */
+		while (*p != NULC && (++p, isxmlspace(*p))) ; /* Skip spaces */
 		if (isquote(*p)) { /* Attribute value starts with a quote, look for next one, ignoring protected ones with '\' */
 			for (nn = p-str+1; str[nn] && str[nn] != *p; nn++) { // CHECK UNICODE "nn = p-str+1"
 				/* if (str[nn] == C2SX('\\')) nn++; [bugs:#7]: '\' is valid in values */
 			}
 		} else { /* Attribute value stops at first space or end of XML string */
-			for (nn = p-str+1; str[nn] != NULC && !sx_isspace(str[nn]) && str[nn] != C2SX('/') && str[nn] != C2SX('>'); nn++) ; /* Go to the end of the attribute value */ // CHECK UNICODE
+			for (nn = p-str+1; str[nn] != NULC && !isxmlspace(str[nn]) && str[nn] != C2SX('/') && str[nn] != C2SX('>'); nn++) ; /* Go to the end of the attribute value */ // CHECK UNICODE
 		}
 		
 		/* Here 'str[nn]' is the character after value */
@@ -1221,480 +1642,3329 @@ parse_err:
 	return TAG_ERROR;
 }
 
-static int _parse_data_SAX(void* in, const DataSourceType in_type, const SAX_Callbacks* sax, SAX_Data* sd)
-{
-	SXML_CHAR *line = NULL, *txt_end, *p;
-	XMLNode node;
-	int ret, exit, sz, n0, ncr;
-	TagType tag_type;
-	int (*meos)(void* ds) = (in_type == DATA_SOURCE_BUFFER ? (int(*)(void*))_beob : (int(*)(void*))sx_feof);
+static size_t _find_char(const SXML_CHAR* str, size_t len, SXML_CHAR c);
+static int _count_char(const SXML_CHAR* str, size_t len, SXML_CHAR c);
+static size_t _scan_to(const SXML_CHAR* str, size_t len, SXML_CHAR to, SXML_CHAR interest, int* n_interest);
+static size_t _blkread(DataSourceBlock* ds, SXML_CHAR* dst, size_t n);
+static size_t _decode_entities(SXML_CHAR* str, size_t len);
 
-	if (sax->start_doc != NULL && !sax->start_doc(sd))
-		return true;
-	if (sax->all_event != NULL && !sax->all_event(XML_EVENT_START_DOC, NULL, (SXML_CHAR*)sd->name, 0, sd))
-		return true;
+/*
+ Report parse error 'err' to 'sax' callbacks (or 'vsax' view callbacks when 'sax' is NULL),
+ or display 'msg' on 'stderr' when there are none.
+ */
+static void _report_error(const SAX_Callbacks* sax, const SAX_View_Callbacks* vsax, SAX_Data* sd, ParseError err, const SXML_CHAR* msg)
+{
+	if (sd->tok != NULL && sd->tok->ctx->lazy_lines)
+		(void)SAX_Data_get_position(sd, &sd->line_num, NULL);
+	if (sax == NULL) {
+		if (vsax->on_error == NULL)
+			sx_fprintf(stderr, C2SX("%s:%d: %s.\n"), sd->name, sd->line_num, msg);
+		else
+			(void)vsax->on_error(err, sd->line_num, sd);
+	} else if (sax->on_error == NULL && sax->all_event == NULL)
+		sx_fprintf(stderr, C2SX("%s:%d: %s.\n"), sd->name, sd->line_num, msg);
+	else {
+		if (sax->on_error != NULL && !sax->on_error(err, sd->line_num, sd))
+			return;
+		if (sax->all_event != NULL)
+			(void)sax->all_event(XML_EVENT_ERROR, NULL, (SXML_CHAR*)sd->name, err, sd);
+	}
+}
 
-	ret = true;
-	exit = false;
-	sd->line_num = 1; /* Line counter, starts at 1 */
-	sz = 0; /* 'line' buffer size */
-	node.init_value = 0;
-	(void)XMLNode_init(&node);
-	while ((n0 = read_line_alloc(in, in_type, &line, &sz, 0, NULC, C2SX('>'), true, C2SX('\n'), &ncr)) != 0) {
-		(void)XMLNode_free(&node);
-		for (p = line; *p != NULC && sx_isspace(*p); p++) ; /* Checks if text is only spaces */
-		if (*p == NULC)
+/*
+ Return the first occurrence of 'sub' (of 'len' characters) in 'str', up to 'str_end', or NULL if not found.
+ */
+static const SXML_CHAR* _find_str(const SXML_CHAR* str, const SXML_CHAR* str_end, const SXML_CHAR* sub, int len)
+{
+	for (; str_end - str >= len; str++) {
+		str += _scan_to(str, str_end - str - len + 1, sub[0], NULC, NULL); /* Only where 'sub' can fit */
+		if (str_end - str < len)
 			break;
-		sd->line_num += ncr;
-
-		/* Get text for 'father' (i.e. what is before '<') */
-		while ((txt_end = sx_strchr(line, C2SX('<'))) == NULL) { /* '<' was not found, indicating a probable '>' inside text (should have been escaped with '&gt;' but we'll handle that ;) */
-			int n1 = read_line_alloc(in, in_type, &line, &sz, n0, 0, C2SX('>'), true, C2SX('\n'), &ncr); /* Go on reading the file from current position until next '>' */
-			sd->line_num += ncr;
-			if (n1 <= n0) {
-				ret = false;
-				if (sax->on_error == NULL && sax->all_event == NULL)
-					sx_fprintf(stderr, C2SX("%s:%d: MEMORY ERROR.\n"), sd->name, sd->line_num);
-				else {
-					if (sax->on_error != NULL && !sax->on_error(PARSE_ERR_MEMORY, sd->line_num, sd))
-						break;
-					if (sax->all_event != NULL && !sax->all_event(XML_EVENT_ERROR, NULL, (SXML_CHAR*)sd->name, PARSE_ERR_MEMORY, sd))
-						break;
-				}
-				break; /* 'txt_end' is still NULL here so we'll display the syntax error below */
-			}
-			n0 = n1;
-		}
-		if (txt_end == NULL) { /* Missing tag start */
-			ret = false;
-			if (sax->on_error == NULL && sax->all_event == NULL)
-				sx_fprintf(stderr, C2SX("%s:%d: ERROR: Unexpected end character '>', without matching '<'!\n"), sd->name, sd->line_num);
-			else {
-				if (sax->on_error != NULL && !sax->on_error(PARSE_ERR_UNEXPECTED_TAG_END, sd->line_num, sd))
-					break;
-				if (sax->all_event != NULL && !sax->all_event(XML_EVENT_ERROR, NULL, (SXML_CHAR*)sd->name, PARSE_ERR_UNEXPECTED_TAG_END, sd))
-					break;
+		if (!sx_strncmp(str, sub, len))
+			return str;
+	}
+
+	return NULL;
+}
+
+/*
+ Zero-copy counterpart of 'XML_parse_1string': parse the tag starting at 'str' (on its '<') and have
+ 'tv' views point to its name, attribute names and values. Nothing is written in 'str' and it does not
+ need to be NUL-terminated: 'str_end' is the end of the characters.
+ '*end' is set to the character following the tag and '*n_lines' (unless NULL) to the number of lines in the tag.
+ Return the tag type, 'TAG_PARTIAL' when the tag end was not found, 'TAG_NONE' for a syntax error
+ or 'TAG_ERROR' for a memory error.
+ */
+static TagType _parse_tag_view(const XMLContext* ctx, const SXML_CHAR* str, const SXML_CHAR* str_end, XMLTagView* tv, const SXML_CHAR** end, int* n_lines)
+{
+	const SXML_CHAR *p, *pe, *name_end, *an, *ane, *av, *ave;
+	XMLAttributeView* pt;
+	size_t len = str_end - str;
+	_TAG* tag = NULL;
+	SXML_CHAR c = (len > 1 ? str[1] : NULC);
+	int i, tag_end;
+
+	tv->n_attributes = 0;
+
+	for (i = 0; i < NB_SPECIAL_TAGS && tag == NULL && IS_SPECIAL_TAG_CHAR(c); i++)
+		if (len >= (size_t)_spec[i].len_start && !sx_strncmp(str, _spec[i].start, _spec[i].len_start))
+			tag = &_spec[i];
+
+	/* "<!DOCTYPE" ends with "]>" instead of ">" if a '[' is found before the first '>' */
+	if (tag == NULL && c == C2SX('!') && len >= 9 && !sx_strncmp(str, C2SX("<!DOCTYPE"), 9)) {
+		if ((pe = str + 9 + _scan_to(str + 9, len - 9, C2SX('>'), NULC, NULL)) == str_end)
+			goto partial;
+		for (p = str + 9; p < pe && *p != C2SX('['); p++) ;
+		if (p < pe && (pe = _find_str(p, str_end, C2SX("]>"), 2)) == NULL)
+			goto partial;
+		*end = pe + (*pe == C2SX('>') ? 1 : 2);
+		tv->tag.ptr = str + 9;
+		tv->tag.len = pe - tv->tag.ptr;
+		tv->tag_type = TAG_DOCTYPE;
+		goto found;
+	}
+
+	for (i = 0; i < ctx->n_user_tags && tag == NULL && IS_USER_TAG_CHAR(ctx, c); i++)
+		if (len >= (size_t)ctx->user_tags[i].len_start && !sx_strncmp(str, ctx->user_tags[i].start, ctx->user_tags[i].len_start))
+			tag = &ctx->user_tags[i];
+
+	if (tag != NULL) {
+		if ((pe = _find_str(str + tag->len_start, str_end, tag->end, tag->len_end)) == NULL)
+			goto partial;
+		*end = pe + tag->len_end;
+		tv->tag.ptr = str + tag->len_start;
+		tv->tag.len = pe - tv->tag.ptr;
+		tv->tag_type = tag->tag_type;
+		goto found;
+	}
+
+	/* Tag name starts at index 1 (or 2 if tag end) and ends at the first space or '/>' */
+	tag_end = (len > 1 && str[1] == C2SX('/'));
+	for (p = str + 1 + tag_end; p < str_end && *p != C2SX('>') && *p != C2SX('/') && !isxmlspace(*p); p++) ;
+	name_end = p;
+
+	/* Look for the tag end, skipping quoted attribute values which can contain '>' */
+	while (p < str_end && *p != C2SX('>')) {
+		if (*p++ == C2SX('=') && !tag_end) {
+			while (p < str_end && isxmlspace(*p)) p++;
+			if (p < str_end && isquote(*p)) {
+				if ((p = p + 1 + _scan_to(p + 1, str_end - p - 1, *p, NULC, NULL)) == str_end)
+					goto partial;
+				p++;
 			}
+		}
+	}
+	if (p == str_end)
+		goto partial;
+	*end = p + 1;
+	tv->tag.ptr = str + 1 + tag_end;
+	tv->tag.len = name_end - tv->tag.ptr;
+	if (tag_end) {
+		tv->tag_type = TAG_END;
+		goto found;
+	}
+	tv->tag_type = (p[-1] == C2SX('/') ? TAG_SELF : TAG_FATHER);
+	pe = (tv->tag_type == TAG_SELF ? p - 1 : p); /* Attributes are before 'pe' */
+
+	for (p = name_end; p < pe; p = ave + 1) {
+		while (p < pe && isxmlspace(*p)) p++;
+		if (p >= pe)
 			break;
+		for (an = p; p < pe && *p != C2SX('=') && !isxmlspace(*p); p++) ;
+		ane = p;
+		while (p < pe && isxmlspace(*p)) p++;
+		if (p >= pe || *p != C2SX('=')) {
+			tv->tag_type = TAG_NONE; /* Malformed attribute */
+			goto found;
 		}
-		/* First part of 'line' (before '<') is to be added to 'father->text' */
-		*txt_end = NULC; /* Have 'line' be the text for 'father' */
-		if (*line != NULC && (sax->new_text != NULL || sax->all_event != NULL)) {
-			if (sax->new_text != NULL && (exit = !sax->new_text(line, sd))) /* no str_unescape(line) */
-				break;
-			if (sax->all_event != NULL && (exit = !sax->all_event(XML_EVENT_TEXT, NULL, line, sd->line_num, sd)))
-				break;
+		for (p++; p < pe && isxmlspace(*p); p++) ;
+		if (p < pe && isquote(*p)) {
+			av = p + 1;
+			ave = av + _scan_to(av, pe - av, *p, NULC, NULL); /* Closing quote was found when looking for tag end */
+		} else {
+			for (av = p; p < pe && !isxmlspace(*p); p++) ;
+			ave = p;
 		}
-		*txt_end = '<'; /* Restores tag start */
-
-		switch (tag_type = XML_parse_1string(txt_end, &node)) {
-			case TAG_ERROR: /* Memory error */
-				ret = false;
-				if (sax->on_error == NULL && sax->all_event == NULL)
-					sx_fprintf(stderr, C2SX("%s:%d: MEMORY ERROR.\n"), sd->name, sd->line_num);
-				else {
-					if (sax->on_error != NULL && (exit = !sax->on_error(PARSE_ERR_MEMORY, sd->line_num, sd)))
-						break;
-					if (sax->all_event != NULL && (exit = !sax->all_event(XML_EVENT_ERROR, NULL, (SXML_CHAR*)sd->name, PARSE_ERR_MEMORY, sd)))
-						break;
-				}
-				break;
-		
-			case TAG_NONE: /* Syntax error */
-				ret = false;
-				p = sx_strchr(txt_end, C2SX('\n'));
-				if (p != NULL)
-					*p = NULC;
-				if (sax->on_error == NULL && sax->all_event == NULL) {
-					sx_fprintf(stderr, C2SX("%s:%d: SYNTAX ERROR (%s%s).\n"), sd->name, sd->line_num, txt_end, p == NULL ? C2SX("") : C2SX("..."));
-					if (p != NULL)
-						*p = C2SX('\n');
-				} else {
-					if (sax->on_error != NULL && (exit = !sax->on_error(PARSE_ERR_SYNTAX, sd->line_num, sd)))
-						break;
-					if (sax->all_event != NULL && (exit = !sax->all_event(XML_EVENT_ERROR, NULL, (SXML_CHAR*)sd->name, PARSE_ERR_SYNTAX, sd)))
-						break;
-				}
-				break;
-
-			case TAG_END:
-				if (sax->end_node != NULL || sax->all_event != NULL) {
-					if (sax->end_node != NULL && (exit = !sax->end_node(&node, sd)))
-						break;
-					if (sax->all_event != NULL && (exit = !sax->all_event(XML_EVENT_END_NODE, &node, NULL, sd->line_num, sd)))
-						break;
-				}
-				break;
 
-			default: /* Add 'node' to 'father' children */
-				/* If the line looks like a comment (or CDATA) but is not properly finished, loop until we find the end. */
-				while (tag_type == TAG_PARTIAL) {
-					int n1 = read_line_alloc(in, in_type, &line, &sz, n0, NULC, C2SX('>'), true, C2SX('\n'), &ncr); /* Go on reading the file from current position until next '>' */
-					sd->line_num += ncr;
-					if (n1 <= n0) {
-						ret = false;
-						if (sax->on_error == NULL && sax->all_event == NULL)
-							sx_fprintf(stderr, C2SX("%s:%d: SYNTAX ERROR.\n"), sd->name, sd->line_num);
-						else {
-							if (sax->on_error != NULL && (exit = !sax->on_error(meos(in) ? PARSE_ERR_EOF : PARSE_ERR_MEMORY, sd->line_num, sd)))
-								break;
-							if (sax->all_event != NULL && (exit = !sax->all_event(XML_EVENT_ERROR, NULL, (SXML_CHAR*)sd->name, meos(in) ? PARSE_ERR_EOF : PARSE_ERR_MEMORY, sd)))
-								break;
-						}
-						break;
-					}
-					n0 = n1;
-					txt_end = sx_strchr(line, C2SX('<')); /* In case 'line' has been moved by the '__realloc' in 'read_line_alloc' */
-					tag_type = XML_parse_1string(txt_end, &node);
-					if (tag_type == TAG_ERROR) {
-						ret = false;
-						if (sax->on_error == NULL && sax->all_event == NULL)
-							sx_fprintf(stderr, C2SX("%s:%d: PARSE ERROR.\n"), sd->name, sd->line_num);
-						else {
-							if (sax->on_error != NULL && (exit = !sax->on_error(meos(in) ? PARSE_ERR_EOF : PARSE_ERR_SYNTAX, sd->line_num, sd)))
-								break;
-							if (sax->all_event != NULL && (exit = !sax->all_event(XML_EVENT_ERROR, NULL, (SXML_CHAR*)sd->name, meos(in) ? PARSE_ERR_EOF : PARSE_ERR_SYNTAX, sd)))
-								break;
-						}
-						break;
-					}
-				}
-				if (ret == false)
-					break;
-				if (sax->start_node != NULL && (exit = !sax->start_node(&node, sd)))
-					break;
-				if (sax->all_event != NULL && (exit = !sax->all_event(XML_EVENT_START_NODE, &node, NULL, sd->line_num, sd)))
-					break;
-				if (node.tag_type != TAG_FATHER && (sax->end_node != NULL || sax->all_event != NULL)) {
-					if (sax->end_node != NULL && (exit = !sax->end_node(&node, sd)))
-						break;
-					if (sax->all_event != NULL && (exit = !sax->all_event(XML_EVENT_END_NODE, &node, NULL, sd->line_num, sd)))
-						break;
-				}
-			break;
+		if (tv->n_attributes >= tv->sz_attributes) {
+			i = (tv->sz_attributes == 0 ? 8 : 2 * tv->sz_attributes);
+			pt = (XMLAttributeView*)_ctx_realloc(ctx, tv->attributes, i * sizeof(XMLAttributeView));
+			if (pt == NULL) {
+				tv->tag_type = TAG_ERROR;
+				goto found;
+			}
+			tv->attributes = pt;
+			tv->sz_attributes = i;
 		}
-		if (exit == true || ret == false || meos(in))
-			break;
+		pt = &tv->attributes[tv->n_attributes++];
+		pt->name.ptr = an;
+		pt->name.len = ane - an;
+		pt->value.ptr = av;
+		pt->value.len = ave - av;
 	}
-	__free(line);
-	(void)XMLNode_free(&node);
 
-	if (sax->end_doc != NULL && !sax->end_doc(sd))
-		return ret;
-	if (sax->all_event != NULL)
-		(void)sax->all_event(XML_EVENT_END_DOC, NULL, (SXML_CHAR*)sd->name, sd->line_num, sd);
+found:
+	if (n_lines != NULL)
+		*n_lines = _count_char(str, *end - str, C2SX('\n'));
 
-	return ret;
+	return tv->tag_type;
+
+partial:
+	if (n_lines != NULL)
+		*n_lines = _count_char(str, len, C2SX('\n'));
+
+	return TAG_PARTIAL;
 }
 
-int SAX_Callbacks_init(SAX_Callbacks* sax)
+/*
+ Have 'node' point to the strings of 'tv', after NUL-terminating them in place for in-situ parsing.
+ Attribute values have their HTML escape sequences converted in place, or all their entities and
+ character references when 'decode' is 'true'.
+ 'node->attributes' is kept from one tag to the other.
+ Return 'false' for memory error.
+ */
+static int _TagView_to_node_insitu(const XMLTagView* tv, XMLNode* node, int decode)
 {
-	if (sax == NULL)
-		return false;
+	XMLAttribute* pt;
+	SXML_CHAR* s;
+	int i;
 
-	sax->start_doc = NULL;
-	sax->start_node = NULL;
-	sax->end_node = NULL;
-	sax->new_text = NULL;
-	sax->on_error = NULL;
-	sax->end_doc = NULL;
-	sax->all_event = NULL;
+	if (tv->n_attributes > node->sz_attributes) {
+		pt = (XMLAttribute*)__realloc(node->attributes, tv->sz_attributes * sizeof(XMLAttribute));
+		if (pt == NULL)
+			return false;
+		node->attributes = pt;
+		node->sz_attributes = tv->sz_attributes;
+	}
+	for (i = 0; i < tv->n_attributes; i++) {
+		s = (SXML_CHAR*)tv->attributes[i].name.ptr;
+		s[tv->attributes[i].name.len] = NULC;
+		node->attributes[i].name = s;
+		s = (SXML_CHAR*)tv->attributes[i].value.ptr;
+		if (decode)
+			s[_decode_entities(s, tv->attributes[i].value.len)] = NULC;
+		else
+			s[tv->attributes[i].value.len] = NULC;
+		node->attributes[i].value = (decode ? s : html2str(s, NULL));
+		node->attributes[i].active = true;
+	}
+	node->n_attributes = tv->n_attributes;
+	s = (SXML_CHAR*)tv->tag.ptr;
+	s[tv->tag.len] = NULC;
+	node->tag = s;
+	node->tag_type = tv->tag_type;
+	node->borrowed = XML_BORROWED_TAG | XML_BORROWED_ATTRIBUTES;
 
 	return true;
 }
 
-int DOMXMLDoc_doc_start(SAX_Data* sd)
-{
-	DOM_through_SAX* dom = (DOM_through_SAX*)sd->user;
+/* Tokenizer states */
+#define TOK_TEXT		0	/* Looking for '<' */
+#define TOK_TAG_START	1	/* '<' found, the kind of tag is to be found */
+#define TOK_ELEMENT		2	/* Looking for '>', outside of attribute values */
+#define TOK_DOCTYPE		3	/* Looking for '>', or for "]>" once a '[' is found */
+#define TOK_SPECIAL		4	/* Looking for the special tag end 'end_str' */
 
-	dom->current = NULL;
-	dom->error = PARSE_ERR_NONE;
-	dom->line_error = 0;
+/*
+ Initialize 'tok' to tokenize the 'len' characters of 'buf', or characters to be added with
+ '_tok_reserve' when 'buf' is NULL, with context 'ctx'.
+ */
+static void _tok_init(XMLTokenizer* tok, SXML_CHAR* buf, size_t len, const XMLContext* ctx)
+{
+	tok->buf = buf;
+	tok->len = len;
+	tok->sz_buf = 0;
+	tok->pos = tok->txt_end = tok->scan = 0;
+	tok->state = TOK_TEXT;
+	tok->end_tag = false;
+	tok->quote = NULC;
+	tok->end_str = NULL;
+	tok->len_end_str = 0;
+	tok->n_lines = 0;
+	tok->offset = tok->line_off = tok->line_start = 0;
+	tok->line_cnt = 0;
+	tok->eos = (buf != NULL);
+	tok->error = PARSE_ERR_NONE;
+	tok->text.ptr = NULL;
+	tok->text.len = 0;
+	tok->tv.attributes = NULL;
+	tok->tv.n_attributes = tok->tv.sz_attributes = 0;
+	tok->depth = 0;
+	tok->skip = 0;
+	tok->ctx = ctx;
+}
 
-	return true;
+static void _tok_free(XMLTokenizer* tok)
+{
+	if (tok->sz_buf > 0)
+		_ctx_free(tok->ctx, tok->buf);
+	if (tok->tv.attributes != NULL)
+		_ctx_free(tok->ctx, tok->tv.attributes);
+	_tok_init(tok, NULL, 0, tok->ctx);
 }
 
-int DOMXMLDoc_node_start(const XMLNode* node, SAX_Data* sd)
+/*
+ Count the line breaks from 'tok->line_off' to the offset 'off' (not before it), which should be
+ in 'tok->buf'.
+ */
+static void _tok_count_lines(XMLTokenizer* tok, size_t off)
 {
-	DOM_through_SAX* dom = (DOM_through_SAX*)sd->user;
-	XMLNode* new_node;
-	int i;
+	const SXML_CHAR* str;
+	size_t i, len;
+
+	if (off <= tok->line_off)
+		return;
+	str = &tok->buf[tok->line_off - tok->offset];
+	len = off - tok->line_off;
+	for (i = _find_char(str, len, C2SX('\n')); i < len; i += 1 + _find_char(&str[i+1], len - i - 1, C2SX('\n'))) {
+		tok->line_cnt++;
+		tok->line_start = tok->line_off + i + 1;
+	}
+	tok->line_off = off;
+}
 
-	if ((new_node = XMLNode_dup(node, true)) == NULL) goto node_start_err; /* No real need to put 'true' for 'XMLNode_dup', but cleaner */
-	
-	if (dom->current == NULL) {
-		if ((i = _add_node(&dom->doc->nodes, &dom->doc->n_nodes, new_node)) < 0) goto node_start_err;
+/*
+ Discard the first 'n' characters of 'tok->buf', which was already tokenized. With lazy lines, line
+ breaks are counted before as they can no longer be.
+ */
+static void _tok_discard(XMLTokenizer* tok, size_t n)
+{
+	if (tok->ctx->lazy_lines)
+		_tok_count_lines(tok, tok->offset + n);
+	tok->offset += n;
+}
 
-		if (dom->doc->i_root < 0 && (node->tag_type == TAG_FATHER || node->tag_type == TAG_SELF))
-			dom->doc->i_root = i;
-	} else {
-		if (_add_node(&dom->current->children, &dom->current->n_children, new_node) < 0) goto node_start_err;
+/*
+ Make room for 'n' more characters at the end of 'tok->buf', discarding the characters already
+ tokenized. Views given by '_tok_next' are no longer valid afterwards.
+ Return the position where to write the characters (then added to 'tok->len'), or NULL for memory error.
+ */
+static SXML_CHAR* _tok_reserve(XMLTokenizer* tok, size_t n)
+{
+	SXML_CHAR* pt;
+	size_t sz;
+
+	if (tok->len + n > tok->sz_buf && tok->pos > 0) {
+		_tok_discard(tok, tok->pos);
+		tok->len -= tok->pos;
+		memmove(tok->buf, &tok->buf[tok->pos], tok->len * sizeof(SXML_CHAR));
+		tok->txt_end -= (tok->txt_end >= tok->pos ? tok->pos : tok->txt_end);
+		tok->scan -= tok->pos;
+		tok->pos = 0;
+	}
+	if (tok->len + n > tok->sz_buf) {
+		sz = 2 * tok->sz_buf;
+		if (sz < tok->len + n)
+			sz = tok->len + n;
+		pt = (SXML_CHAR*)_ctx_realloc(tok->ctx, tok->buf, sz * sizeof(SXML_CHAR));
+		if (pt == NULL)
+			return NULL;
+		tok->buf = pt;
+		tok->sz_buf = sz;
 	}
 
-	new_node->father = dom->current;
-	dom->current = new_node;
-
-	return true;
+	return &tok->buf[tok->len];
+}
 
-node_start_err:
-	dom->error = PARSE_ERR_MEMORY;
-	dom->line_error = sd->line_num;
-	(void)XMLNode_free(new_node);
-	__free(new_node);
+/*
+ Return 1 when the 'len' characters of 'str' start with 'start' ('len_start' characters), 0 when
+ they do not, or -1 when there are too few of them to tell and more can come ('eos' is 'false').
+ */
+static int _starts_with(const SXML_CHAR* str, size_t len, const SXML_CHAR* start, int len_start, int eos)
+{
+	if (len >= (size_t)len_start)
+		return !sx_strncmp(str, start, len_start);
+	if (eos || sx_strncmp(str, start, len))
+		return 0;
 
-	return false;
+	return -1;
 }
 
-int DOMXMLDoc_node_end(const XMLNode* node, SAX_Data* sd)
+/*
+ Find the kind of the tag starting at 'tok->txt_end' and set the state to scan for its end.
+ Return 'false' when more characters are needed to tell.
+ */
+static int _tok_tag_start(XMLTokenizer* tok)
 {
-	DOM_through_SAX* dom = (DOM_through_SAX*)sd->user;
+	const SXML_CHAR* str = &tok->buf[tok->txt_end];
+	size_t len = tok->len - tok->txt_end;
+	_TAG* tag = NULL;
+	SXML_CHAR c;
+	int i, k;
 
-	if (dom->current == NULL || sx_strcmp(dom->current->tag, node->tag)) {
-		sx_fprintf(stderr, C2SX("%s:%d: ERROR - End tag </%s> was unexpected"), sd->name, sd->line_num, node->tag);
-		if (dom->current != NULL)
-			sx_fprintf(stderr, C2SX(" (</%s> was expected)\n"), dom->current->tag);
-		else
-			sx_fprintf(stderr, C2SX(" (no node to end)\n"));
+	if (len < 2 && !tok->eos)
+		return false;
+	c = (len > 1 ? str[1] : NULC);
 
-		dom->error = PARSE_ERR_UNEXPECTED_NODE_END;
-		dom->line_error = sd->line_num;
+	/* Same precedence as '_parse_tag_view': special tags, "<!DOCTYPE", user tags then elements */
+	for (i = 0; i < NB_SPECIAL_TAGS && tag == NULL && IS_SPECIAL_TAG_CHAR(c); i++)
+		if ((k = _starts_with(str, len, _spec[i].start, _spec[i].len_start, tok->eos)) != 0) {
+			if (k < 0)
+				return false;
+			tag = &_spec[i];
+		}
+	if (tag == NULL && c == C2SX('!')) {
+		if ((k = _starts_with(str, len, C2SX("<!DOCTYPE"), 9, tok->eos)) < 0)
+			return false;
+		if (k > 0) {
+			tok->state = TOK_DOCTYPE;
+			tok->scan = tok->txt_end + 9;
+			return true;
+		}
+	}
+	for (i = 0; i < tok->ctx->n_user_tags && tag == NULL && IS_USER_TAG_CHAR(tok->ctx, c); i++)
+		if ((k = _starts_with(str, len, tok->ctx->user_tags[i].start, tok->ctx->user_tags[i].len_start, tok->eos)) != 0) {
+			if (k < 0)
+				return false;
+			tag = &tok->ctx->user_tags[i];
+		}
 
-		return false;
+	if (tag != NULL) {
+		tok->state = TOK_SPECIAL;
+		tok->end_str = tag->end;
+		tok->len_end_str = tag->len_end;
+		tok->scan = tok->txt_end + tag->len_start;
+		return true;
 	}
 
-	dom->current = dom->current->father;
+	tok->state = TOK_ELEMENT;
+	tok->end_tag = (len > 1 && str[1] == C2SX('/'));
+	tok->quote = NULC;
+	tok->scan = tok->txt_end + 1 + tok->end_tag;
 
 	return true;
 }
 
-int DOMXMLDoc_node_text(SXML_CHAR* text, SAX_Data* sd)
+/*
+ Scan for the end of the current tag, from 'tok->scan' in state 'tok->state'.
+ Return the position following the tag, or 0 when more characters are needed.
+ */
+static size_t _tok_tag_end(XMLTokenizer* tok)
 {
-	SXML_CHAR* p = text;
-	DOM_through_SAX* dom = (DOM_through_SAX*)sd->user;
-
-	/* Keep text, even if it is only spaces */
-#if 0
-	while(*p != NULC && sx_isspace(*p++)) ;
-	if (*p == NULC) return true; /* Only spaces */
-#endif
+	const SXML_CHAR *p, *buf_end = &tok->buf[tok->len];
+	size_t i, j;
+
+	if (tok->state == TOK_DOCTYPE) {
+		i = tok->scan + _scan_to(&tok->buf[tok->scan], tok->len - tok->scan, C2SX('>'), NULC, NULL);
+		j = tok->scan + _find_char(&tok->buf[tok->scan], i - tok->scan, C2SX('['));
+		if (j == i) {
+			tok->scan = i;
+			return (i < tok->len ? i + 1 : 0);
+		}
+		/* "<!DOCTYPE" ends with "]>" instead of ">" if a '[' is found before the first '>' */
+		tok->state = TOK_SPECIAL;
+		tok->end_str = C2SX("]>");
+		tok->len_end_str = 2;
+		tok->scan = j;
+	}
 
-	/* If there is no current node to add text to, raise an error, except if text is only spaces, in which case it is probably just formatting */
-	if (dom->current == NULL) {
-		while(*p != NULC && sx_isspace(*p++)) ;
-		if (*p == NULC) /* Only spaces => probably pretty-printing */
-			return true;
-		dom->error = PARSE_ERR_TEXT_OUTSIDE_NODE;
-		dom->line_error = sd->line_num;
-		return false; /* There is some "real" text => raise an error */
+	if (tok->state == TOK_SPECIAL) {
+		p = _find_str(&tok->buf[tok->scan], buf_end, tok->end_str, tok->len_end_str);
+		if (p != NULL)
+			return (p - tok->buf) + tok->len_end_str;
+		/* The end can start in the last characters */
+		if (tok->len - tok->scan >= (size_t)tok->len_end_str)
+			tok->scan = tok->len - tok->len_end_str + 1;
+		return 0;
 	}
 
-	if (dom->text_as_nodes) {
-		XMLNode* new_node = XMLNode_allocN(1);
-		if (new_node == NULL || (new_node->text = sx_strdup(text)) == NULL
-			|| _add_node(&dom->current->children, &dom->current->n_children, new_node) < 0) {
-			dom->error = PARSE_ERR_MEMORY;
-			dom->line_error = sd->line_num;
-			(void)XMLNode_free(new_node);
-			__free(new_node);
-			return false;
-		}
-		new_node->tag_type = TAG_TEXT;
-		new_node->father = dom->current;
-		//dom->current->tag_type = TAG_FATHER; // OS: should parent field be forced to be TAG_FATHER? now it has at least one TAG_TEXT child. I decided not to enforce this to enforce backward-compatibility related to tag_types
-		return true;
-	} else { /* Old behaviour: concatenate text to the previous one */
-		/* 'p' will point at the new text */
-		if (dom->current->text == NULL) {
-			p = sx_strdup(text);
-		} else {
-			p = (SXML_CHAR*)__realloc(dom->current->text, (sx_strlen(dom->current->text) + sx_strlen(text) + 1)*sizeof(SXML_CHAR));
-			if (p != NULL)
-				sx_strcat(p, text);
+	/* Look for the tag end, skipping quoted attribute values which can contain '>' */
+	for (p = &tok->buf[tok->scan]; p < buf_end; ) {
+		if (tok->quote != NULC && tok->quote != C2SX('=')) {
+			if ((p += _scan_to(p, buf_end - p, tok->quote, NULC, NULL)) == buf_end)
+				break;
+			p++;
+			tok->quote = NULC;
+			continue;
 		}
-		if (p == NULL) {
-			dom->error = PARSE_ERR_MEMORY;
-			dom->line_error = sd->line_num;
-			return false;
+		if (tok->quote == C2SX('=')) { /* Spaces can be found between '=' and the quote */
+			if (isxmlspace(*p)) {
+				p++;
+				continue;
+			}
+			tok->quote = (isquote(*p) ? *p++ : NULC);
+			continue;
 		}
-		
-		dom->current->text = p;
+		if (*p == C2SX('>'))
+			return (p - tok->buf) + 1;
+		if (*p++ == C2SX('=') && !tok->end_tag)
+			tok->quote = C2SX('=');
 	}
+	tok->scan = tok->len;
 
-	return true;
+	return 0;
 }
 
-int DOMXMLDoc_parse_error(ParseError error_num, int line_number, SAX_Data* sd)
+/*
+ Return 'TAG_PARTIAL' to wait for more characters, or 'TAG_NONE' when the characters pending
+ already exceed the token size limit of the context.
+ */
+static TagType _tok_partial(XMLTokenizer* tok)
 {
-	DOM_through_SAX* dom = (DOM_through_SAX*)sd->user;
+	if (tok->ctx->max_token == 0 || tok->len - tok->pos <= tok->ctx->max_token)
+		return TAG_PARTIAL;
+	tok->error = PARSE_ERR_LIMIT;
 
-	dom->error = error_num;
-	dom->line_error = line_number;
+	return TAG_NONE;
+}
 
-	/* Complete error message will be displayed in 'DOMXMLDoc_doc_end' callback */
+/*
+ Update the depth of 'tok' with the tag found, of type 'tag_type', ending a token (text and tag) of 'len'
+ characters. Return 'true' if a limit of the context is exceeded.
+ */
+static int _tok_limits(XMLTokenizer* tok, TagType tag_type, size_t len)
+{
+	const XMLContext* ctx = tok->ctx;
 
-	return false; /* Stop on error */
+	if (tag_type == TAG_FATHER)
+		tok->depth++;
+	else if (tag_type == TAG_END && tok->depth > 0)
+		tok->depth--;
+
+	return ((ctx->max_token > 0 && len > ctx->max_token)
+		|| (ctx->max_attributes > 0 && tok->tv.n_attributes > ctx->max_attributes)
+		|| (ctx->max_depth > 0 && tok->depth > ctx->max_depth));
 }
 
-int DOMXMLDoc_doc_end(SAX_Data* sd)
+/*
+ Find the next text and tag in 'tok', setting 'tok->text' and 'tok->tv' and the number of
+ lines they contain in '*n_lines'.
+ Return the tag type, 'TAG_PARTIAL' when more characters are needed (or at the end of the document
+ when 'tok->eos' is 'true'), or 'TAG_NONE'/'TAG_ERROR' for an error given by 'tok->error'.
+ When the document ends inside a tag, the text before it is also given.
+ While 'tok->skip' is set, texts and tags are passed over up to the end tag closing the subtree.
+ */
+static TagType _tok_next(XMLTokenizer* tok, int* n_lines)
 {
-	DOM_through_SAX* dom = (DOM_through_SAX*)sd->user;
+	const SXML_CHAR* end;
+	size_t i;
+	TagType tag_type;
+	int n;
 
-	if (dom->error != PARSE_ERR_NONE) {
-		SXML_CHAR* msg;
-
-		switch (dom->error) {
-			case PARSE_ERR_MEMORY:				msg = C2SX("MEMORY"); break;
-			case PARSE_ERR_UNEXPECTED_TAG_END:	msg = C2SX("UNEXPECTED_TAG_END"); break;
-			case PARSE_ERR_SYNTAX:				msg = C2SX("SYNTAX"); break;
-			case PARSE_ERR_EOF:					msg = C2SX("UNEXPECTED_END_OF_FILE"); break;
-			case PARSE_ERR_TEXT_OUTSIDE_NODE:	msg = C2SX("TEXT_OUTSIDE_NODE"); break;
-			case PARSE_ERR_UNEXPECTED_NODE_END:	msg = C2SX("UNEXPECTED_NODE_END"); break;
-			default:							msg = C2SX("UNKNOWN"); break;
-		}
-		sx_fprintf(stderr, C2SX("%s:%d: An error was found (%s), loading aborted...\n"), sd->name, dom->line_error, msg);
-		dom->current = NULL;
-		(void)XMLDoc_free(dom->doc);
-		dom->doc = NULL;
+	*n_lines = 0;
+next:
+	tok->text.ptr = &tok->buf[tok->pos];
+	tok->text.len = 0;
+
+	if (tok->state == TOK_TEXT) {
+		if (tok->ctx->lazy_lines)
+			i = tok->scan + _find_char(&tok->buf[tok->scan], tok->len - tok->scan, C2SX('<'));
+		else
+			i = tok->scan + _scan_to(&tok->buf[tok->scan], tok->len - tok->scan, C2SX('<'), C2SX('\n'), &tok->n_lines);
+		tok->scan = i;
+		if (i == tok->len) {
+			if (!tok->eos)
+				return _tok_partial(tok);
+			/* Only spaces are allowed after the last tag */
+			for (i = tok->pos; i < tok->len && isxmlspace(tok->buf[i]); i++) ;
+			if (i == tok->len) {
+				tok->pos = tok->len;
+				return TAG_PARTIAL;
+			}
+			*n_lines = tok->n_lines;
+			if (_find_char(&tok->buf[tok->pos], tok->len - tok->pos, C2SX('>')) < tok->len - tok->pos)
+				tok->error = PARSE_ERR_UNEXPECTED_TAG_END;
+			else
+				tok->error = PARSE_ERR_EOF;
+			return TAG_NONE;
+		}
+		tok->txt_end = i;
+		tok->state = TOK_TAG_START;
 	}
 
-	return true;
+	if (tok->state == TOK_TAG_START && !_tok_tag_start(tok))
+		goto more;
+	if ((i = _tok_tag_end(tok)) == 0)
+		goto more;
+
+	if (tok->skip > 0) { /* Only element tags are told apart to follow the depth */
+		if (tok->state == TOK_ELEMENT)
+			tok->skip += (tok->end_tag ? -1 : (tok->buf[i - 2] == C2SX('/') ? 0 : 1));
+		if (tok->skip > 0) {
+			if (!tok->ctx->lazy_lines)
+				tok->n_lines += _count_char(&tok->buf[tok->txt_end], i - tok->txt_end, C2SX('\n'));
+			tok->pos = tok->scan = i;
+			tok->state = TOK_TEXT;
+			goto next;
+		}
+		/* Matching end tag, given without the text before it */
+		tok->pos = tok->txt_end;
+		tok->text.ptr = &tok->buf[tok->pos];
+	}
+
+	tok->text.len = tok->txt_end - tok->pos;
+	n = 0;
+	tag_type = _parse_tag_view(tok->ctx, &tok->buf[tok->txt_end], &tok->buf[i], &tok->tv, &end, tok->ctx->lazy_lines ? NULL : &n);
+	*n_lines = tok->n_lines + n;
+	tok->n_lines = 0;
+	n = (tag_type > TAG_PARTIAL && _tok_limits(tok, tag_type, i - tok->pos));
+	tok->pos = tok->scan = i;
+	tok->state = TOK_TEXT;
+	if (tag_type == TAG_ERROR)
+		tok->error = PARSE_ERR_MEMORY;
+	else if (tag_type <= TAG_PARTIAL) {
+		tok->error = PARSE_ERR_SYNTAX;
+		tag_type = TAG_NONE;
+	} else if (n) {
+		tok->error = PARSE_ERR_LIMIT;
+		tag_type = TAG_NONE;
+	}
+
+	return tag_type;
+
+more:
+	if (!tok->eos)
+		return _tok_partial(tok);
+	/* Document ends inside a tag */
+	tok->text.len = tok->txt_end - tok->pos;
+	if (!tok->ctx->lazy_lines)
+		*n_lines = tok->n_lines + _count_char(&tok->buf[tok->txt_end], tok->len - tok->txt_end, C2SX('\n'));
+	tok->error = PARSE_ERR_EOF;
+
+	return TAG_NONE;
 }
 
-int SAX_Callbacks_init_DOM(SAX_Callbacks* sax)
+static void _XMLParser_init(XMLParser* sl, SXML_CHAR* buf, size_t len, int in_place, const SAX_Callbacks* sax, const SAX_View_Callbacks* vsax, SAX_Data* sd, const XMLContext* ctx)
 {
-	if (sax == NULL)
+	_tok_init(&sl->tok, buf, len, ctx);
+	sl->sax = sax;
+	sl->vsax = vsax;
+	sl->sd = sd;
+	sd->offset = 0;
+	sd->skip_subtree = false;
+	sd->tok = &sl->tok;
+	sl->in_place = in_place;
+	sl->line = NULL;
+	sl->sz_line = 0;
+	sl->node.init_value = 0;
+	(void)XMLNode_init(&sl->node);
+	sl->ret = true;
+	sl->started = true;
+	sl->done = false;
+	sl->init_value = XML_INIT_DONE;
+}
+
+/*
+ Call the start document callbacks. Return 'false' if parsing should stop.
+ */
+static int _XMLParser_start(XMLParser* sl)
+{
+	sl->sd->line_num = 1; /* Line counter, starts at 1 */
+	if (sl->sax == NULL)
+		return (sl->vsax->start_doc == NULL || sl->vsax->start_doc(sl->sd));
+	if (sl->sax->start_doc != NULL && !sl->sax->start_doc(sl->sd))
+		return false;
+	if (sl->sax->all_event != NULL && !sl->sax->all_event(XML_EVENT_START_DOC, NULL, (SXML_CHAR*)sl->sd->name, 0, sl->sd))
+		return false;
+
+	return true;
+}
+
+/*
+ Make the text and tag found by the tokenizer NUL-terminated strings for 'sax' callbacks, in place or
+ in 'sl->line' when 'tok.buf' cannot be modified (or with lazy lines), and have 'sl->node' point to the tag strings.
+ Return the text, or NULL for memory error.
+ */
+static SXML_CHAR* _XMLParser_strings(XMLParser* sl, TagType tag_type)
+{
+	XMLTokenizer* tok = &sl->tok;
+	const SXML_CHAR* base = tok->text.ptr;
+	SXML_CHAR *text, *pt;
+	size_t n = (tag_type > TAG_PARTIAL ? (size_t)(&tok->buf[tok->pos] - base) : tok->text.len);
+	int i;
+
+	if (sl->in_place && !tok->ctx->lazy_lines) /* Lazy lines need the line breaks the NULs would overwrite */
+		text = (SXML_CHAR*)base;
+	else {
+		if (n + 1 > sl->sz_line) {
+			pt = (SXML_CHAR*)_ctx_realloc(tok->ctx, sl->line, (n + MEM_INCR_RLA) * sizeof(SXML_CHAR));
+			if (pt == NULL)
+				return NULL;
+			sl->line = pt;
+			sl->sz_line = n + MEM_INCR_RLA;
+		}
+		text = sl->line;
+		memcpy(text, base, n * sizeof(SXML_CHAR));
+		if (tag_type > TAG_PARTIAL) { /* Views now point inside the copy */
+			tok->tv.tag.ptr = text + (tok->tv.tag.ptr - base);
+			for (i = 0; i < tok->tv.n_attributes; i++) {
+				tok->tv.attributes[i].name.ptr = text + (tok->tv.attributes[i].name.ptr - base);
+				tok->tv.attributes[i].value.ptr = text + (tok->tv.attributes[i].value.ptr - base);
+			}
+		}
+	}
+	if (tag_type > TAG_PARTIAL && !_TagView_to_node_insitu(&tok->tv, &sl->node, tok->ctx->decode_entities))
+		return NULL;
+	if (tok->ctx->decode_entities)
+		text[_decode_entities(text, tok->text.len)] = NULC;
+	else
+		text[tok->text.len] = NULC; /* On the tag '<' */
+
+	return text;
+}
+
+/*
+ Call the callbacks for all the complete texts and tags available in the tokenizer.
+ Return 'true' when more characters are needed, 'false' when parsing is over (end of document,
+ error or stopped by a callback).
+ */
+static int _XMLParser_run(XMLParser* sl)
+{
+	XMLTokenizer* tok = &sl->tok;
+	const SAX_Callbacks* sax = sl->sax;
+	const SAX_View_Callbacks* vsax = sl->vsax;
+	SAX_Data* sd = sl->sd;
+	XMLNode* node = &sl->node;
+	SXML_CHAR* text = NULL;
+	TagType tag_type;
+	int n_lines, exit = false;
+
+	while (true) {
+		tag_type = _tok_next(tok, &n_lines);
+		sd->line_num += n_lines;
+		if (tag_type == TAG_PARTIAL)
+			return !tok->eos;
+
+		if (sax != NULL && (text = _XMLParser_strings(sl, tag_type)) == NULL) {
+			tag_type = TAG_ERROR;
+			tok->error = PARSE_ERR_MEMORY;
+			tok->text.len = 0;
+		}
+		sd->offset = tok->offset + (tok->text.ptr - tok->buf);
+		if (tok->text.len > 0) {
+			if (sax == NULL) {
+				if (vsax->new_text != NULL && !vsax->new_text(&tok->text, sd))
+					return false;
+			} else {
+				if (sax->new_text != NULL && !sax->new_text(text, sd))
+					return false;
+				if (sax->all_event != NULL && !sax->all_event(XML_EVENT_TEXT, NULL, text, sd->line_num, sd))
+					return false;
+			}
+		}
+
+		sd->offset += tok->text.len;
+		switch (tag_type) {
+			case TAG_ERROR:
+			case TAG_NONE:
+				sl->ret = false;
+				_report_error(sax, vsax, sd, tok->error, tok->error == PARSE_ERR_MEMORY ? C2SX("MEMORY ERROR")
+					: tok->error == PARSE_ERR_UNEXPECTED_TAG_END ? C2SX("ERROR: Unexpected end character '>', without matching '<'!")
+					: tok->error == PARSE_ERR_LIMIT ? C2SX("ERROR: Parser limit exceeded")
+					: C2SX("SYNTAX ERROR"));
+				return false;
+
+			case TAG_END:
+				if (sax == NULL) {
+					exit = (vsax->end_node != NULL && !vsax->end_node(&tok->tv.tag, TAG_END, sd));
+					break;
+				}
+				if (sax->end_node != NULL && (exit = !sax->end_node(node, sd)))
+					break;
+				if (sax->all_event != NULL && (exit = !sax->all_event(XML_EVENT_END_NODE, node, NULL, sd->line_num, sd)))
+					break;
+				break;
+
+			default:
+				if (sax == NULL) {
+					if (vsax->start_node != NULL && (exit = !vsax->start_node(&tok->tv.tag, tag_type, tok->tv.attributes, tok->tv.n_attributes, sd)))
+						break;
+					if (tag_type != TAG_FATHER && vsax->end_node != NULL)
+						exit = !vsax->end_node(&tok->tv.tag, tag_type, sd);
+					break;
+				}
+				if (sax->start_node != NULL && (exit = !sax->start_node(node, sd)))
+					break;
+				if (sax->all_event != NULL && (exit = !sax->all_event(XML_EVENT_START_NODE, node, NULL, sd->line_num, sd)))
+					break;
+				if (node->tag_type != TAG_FATHER) {
+					if (sax->end_node != NULL && (exit = !sax->end_node(node, sd)))
+						break;
+					if (sax->all_event != NULL && (exit = !sax->all_event(XML_EVENT_END_NODE, node, NULL, sd->line_num, sd)))
+						break;
+				}
+				break;
+		}
+		if (exit)
+			return false;
+		if (sd->skip_subtree) {
+			sd->skip_subtree = false;
+			if (tag_type == TAG_FATHER)
+				tok->skip = 1;
+		}
+	}
+}
+
+static void _XMLParser_release(XMLParser* sl)
+{
+	_tok_free(&sl->tok);
+	if (sl->line != NULL)
+		_ctx_free(sl->tok.ctx, sl->line);
+	sl->line = NULL;
+	sl->sz_line = 0;
+	(void)XMLNode_free(&sl->node);
+}
+
+/*
+ Release 'sl' and call the end document callbacks.
+ Return 'false' if an error occurred during parsing.
+ */
+static int _XMLParser_end(XMLParser* sl)
+{
+	_XMLParser_release(sl);
+	sl->sd->tok = NULL;
+
+	if (sl->sax == NULL) {
+		if (sl->vsax->end_doc != NULL)
+			(void)sl->vsax->end_doc(sl->sd);
+		return sl->ret;
+	}
+	if (sl->sax->end_doc != NULL && !sl->sax->end_doc(sl->sd))
+		return sl->ret;
+	if (sl->sax->all_event != NULL)
+		(void)sl->sax->all_event(XML_EVENT_END_DOC, NULL, (SXML_CHAR*)sl->sd->name, sl->sd->line_num, sl->sd);
+
+	return sl->ret;
+}
+
+/*
+ Parse the 'len' characters of 'buf' without copying them, calling view callbacks 'vsax'.
+ When 'sax' is not NULL, 'buf' is mutable and parsed in-situ for 'sax' callbacks instead:
+ views are NUL-terminated in place and given to the callbacks through a node.
+ */
+static int _parse_view_SAX(const SXML_CHAR* buf, size_t len, const SAX_View_Callbacks* vsax, const SAX_Callbacks* sax, SAX_Data* sd)
+{
+	XMLParser sl;
+
+	_XMLParser_init(&sl, (SXML_CHAR*)buf, len, true, sax, vsax, sd, &_default_ctx);
+	if (!_XMLParser_start(&sl))
+		return true;
+	(void)_XMLParser_run(&sl);
+
+	return _XMLParser_end(&sl);
+}
+
+/*
+ Parse data read from the block data source 'ds' with the context 'ctx', calling SAX callbacks 'sax'.
+ Characters are read by blocks and tokenized as they come, incomplete tags being resumed when
+ the next block is read. When 'ds' is a buffer, it is tokenized directly.
+ 'ds' is not released, that is the responsibility of the caller.
+ */
+static int _parse_data_SAX(DataSourceBlock* ds, const SAX_Callbacks* sax, SAX_Data* sd, const XMLContext* ctx)
+{
+	XMLParser sl;
+	SXML_CHAR* p;
+
+	if (ds->sz_blk == 0)
+		_XMLParser_init(&sl, &ds->blk[ds->pos], ds->len - ds->pos, false, sax, NULL, sd, ctx);
+	else
+		_XMLParser_init(&sl, NULL, 0, true, sax, NULL, sd, ctx);
+	if (!_XMLParser_start(&sl))
+		return true;
+
+	while (_XMLParser_run(&sl)) {
+		if ((p = _tok_reserve(&sl.tok, ds->sz_blk)) == NULL) {
+			sl.ret = false;
+			_report_error(sax, NULL, sd, PARSE_ERR_MEMORY, C2SX("MEMORY ERROR"));
+			break;
+		}
+		sl.tok.len += _blkread(ds, p, ds->sz_blk);
+		if (ds->error) {
+			sl.ret = false;
+			_report_error(sax, NULL, sd, PARSE_ERR_READ, C2SX("READ ERROR"));
+			break;
+		}
+		sl.tok.eos = _blkeob(ds);
+	}
+	if (ds->sz_blk == 0)
+		ds->pos += sl.tok.pos;
+
+	return _XMLParser_end(&sl);
+}
+
+int XMLParser_init(XMLParser* parser, const SXML_CHAR* name, const SAX_Callbacks* sax, void* user)
+{
+	return XMLParser_init_ctx(parser, name, sax, user, NULL);
+}
+
+int XMLParser_init_ctx(XMLParser* parser, const SXML_CHAR* name, const SAX_Callbacks* sax, void* user, const XMLContext* ctx)
+{
+	if (parser == NULL || sax == NULL || (ctx != NULL && ctx->init_value != XML_INIT_DONE))
+		return false;
+
+	parser->data.name = name;
+	parser->data.user = user;
+	parser->data.insitu = false;
+	_XMLParser_init(parser, NULL, 0, true, sax, NULL, &parser->data, ctx != NULL ? ctx : &_default_ctx);
+	parser->started = _XMLParser_start(parser);
+	parser->done = !parser->started;
+
+	return true;
+}
+
+int XMLParser_feed(XMLParser* parser, const SXML_CHAR* chunk, size_t len)
+{
+	XMLTokenizer* tok;
+	SXML_CHAR *buf, *p;
+	size_t sz_buf;
+
+	if (parser == NULL || parser->init_value != XML_INIT_DONE || (chunk == NULL && len > 0))
+		return false;
+	if (parser->done)
+		return false;
+
+	tok = &parser->tok;
+	if (tok->pos < tok->len) { /* Complete the pending text or tag */
+		if ((p = _tok_reserve(tok, len)) == NULL)
+			goto mem_err;
+		memcpy(p, chunk, len * sizeof(SXML_CHAR));
+		tok->len += len;
+		parser->done = !_XMLParser_run(parser);
+		return !parser->done;
+	}
+
+	/* Nothing pending: 'chunk' is tokenized where it is and only its unfinished end is kept */
+	_tok_discard(tok, tok->len);
+	buf = tok->buf;
+	sz_buf = tok->sz_buf;
+	tok->buf = (SXML_CHAR*)chunk;
+	tok->len = len;
+	tok->sz_buf = 0;
+	tok->pos = tok->txt_end = tok->scan = 0;
+	parser->in_place = false;
+	parser->done = !_XMLParser_run(parser);
+	parser->in_place = true;
+
+	_tok_discard(tok, tok->pos);
+	chunk += tok->pos;
+	len -= tok->pos;
+	tok->txt_end -= (tok->txt_end >= tok->pos ? tok->pos : tok->txt_end);
+	tok->scan -= tok->pos;
+	tok->buf = buf;
+	tok->sz_buf = sz_buf;
+	tok->len = tok->pos = 0;
+	if (parser->done || len == 0)
+		return !parser->done;
+	if ((p = _tok_reserve(tok, len)) == NULL)
+		goto mem_err;
+	memcpy(p, chunk, len * sizeof(SXML_CHAR));
+	tok->len = len;
+
+	return true;
+
+mem_err:
+	parser->ret = false;
+	parser->done = true;
+	_report_error(parser->sax, NULL, parser->sd, PARSE_ERR_MEMORY, C2SX("MEMORY ERROR"));
+
+	return false;
+}
+
+int XMLParser_finish(XMLParser* parser)
+{
+	if (parser == NULL || parser->init_value != XML_INIT_DONE)
+		return false;
+
+	if (!parser->done) {
+		parser->tok.eos = true;
+		(void)_XMLParser_run(parser);
+	}
+	parser->init_value = 0;
+	if (!parser->started) { /* No 'end_doc' callback either, as other parsing functions */
+		_tok_free(&parser->tok);
+		return true;
+	}
+
+	return _XMLParser_end(parser);
+}
+
+int SAX_Data_get_position(SAX_Data* sd, int* line, int* column)
+{
+	XMLTokenizer* tok;
+	size_t off, i;
+	int n;
+
+	if (sd == NULL || sd->tok == NULL || !sd->tok->ctx->lazy_lines)
+		return false;
+
+	tok = sd->tok;
+	off = sd->offset;
+	if (off > tok->offset + tok->len)
+		off = tok->offset + tok->len;
+	if (off < tok->offset) /* Already discarded */
+		return false;
+
+	if (off >= tok->line_off) {
+		_tok_count_lines(tok, off);
+		n = tok->line_cnt;
+		i = tok->line_start;
+	} else { /* Before the line breaks counted so far: count back */
+		n = tok->line_cnt - _count_char(&tok->buf[off - tok->offset], tok->line_off - off, C2SX('\n'));
+		for (i = off; i > tok->offset && tok->buf[i - 1 - tok->offset] != C2SX('\n'); i--) ;
+		if (i == tok->offset && n == tok->line_cnt)
+			i = tok->line_start;
+		else if (i == tok->offset && i > 0)
+			i = off + 1; /* Line start discarded */
+	}
+	if (line != NULL)
+		*line = n + 1;
+	if (column != NULL)
+		*column = (i <= off ? (int)(off - i) + 1 : 0);
+
+	return true;
+}
+
+int SAX_Callbacks_init(SAX_Callbacks* sax)
+{
+	if (sax == NULL)
+		return false;
+
+	sax->start_doc = NULL;
+	sax->start_node = NULL;
+	sax->end_node = NULL;
+	sax->new_text = NULL;
+	sax->on_error = NULL;
+	sax->end_doc = NULL;
+	sax->all_event = NULL;
+
+	return true;
+}
+
+int SAX_View_Callbacks_init(SAX_View_Callbacks* sax)
+{
+	if (sax == NULL)
+		return false;
+
+	sax->start_doc = NULL;
+	sax->start_node = NULL;
+	sax->end_node = NULL;
+	sax->new_text = NULL;
+	sax->on_error = NULL;
+	sax->end_doc = NULL;
+
+	return true;
+}
+
+int DOMXMLDoc_doc_start(SAX_Data* sd)
+{
+	DOM_through_SAX* dom = (DOM_through_SAX*)sd->user;
+
+	dom->current = NULL;
+	dom->error = PARSE_ERR_NONE;
+	dom->line_error = 0;
+
+	return true;
+}
+
+/*
+ Duplicate 'node' (without children) but keep its tag and attribute strings, which are
+ flagged as borrowed in the new node. Only valid when these strings outlive the new node,
+ as for in-situ parsing.
+ */
+static XMLNode* _XMLNode_dup_borrowed(const XMLNode* node)
+{
+	XMLNode* n = XMLNode_allocN(1);
+
+	if (n == NULL)
+		return NULL;
+
+	if (node->n_attributes > 0) {
+		n->attributes = (XMLAttribute*)__malloc(node->n_attributes * sizeof(XMLAttribute));
+		if (n->attributes == NULL) {
+			__free(n);
+			return NULL;
+		}
+		memcpy(n->attributes, node->attributes, node->n_attributes * sizeof(XMLAttribute));
+		n->n_attributes = n->sz_attributes = node->n_attributes;
+	}
+	n->tag = node->tag;
+	n->tag_type = node->tag_type;
+	n->user = node->user;
+	n->active = node->active;
+	n->borrowed = XML_BORROWED_TAG | XML_BORROWED_ATTRIBUTES;
+
+	return n;
+}
+
+/*
+ Duplicate 'node' (without children) in 'arena', with its tag and attribute strings. Strings
+ borrowed by 'node' are borrowed as well when 'insitu' is 'true', as they outlive the new node.
+ The new node is flagged as belonging to the arena, along with its strings.
+ */
+static XMLNode* _XMLNode_dup_arena(const XMLNode* node, XMLArena* arena, int insitu)
+{
+	XMLNode* n = (XMLNode*)_arena_alloc(arena, sizeof(XMLNode));
+	int i, borrow_attributes = insitu && (node->borrowed & XML_BORROWED_ATTRIBUTES);
+
+	if (n == NULL)
+		return NULL;
+
+	n->init_value = 0; /* Arena memory is not cleared */
+	(void)XMLNode_init(n);
+	n->borrowed = XML_BORROWED_NODE | XML_BORROWED_TAG | XML_BORROWED_TEXT | XML_BORROWED_ATTRIBUTES;
+	if (node->tag != NULL && (n->tag = (insitu && (node->borrowed & XML_BORROWED_TAG) ? node->tag : _arena_strdup(arena, node->tag))) == NULL)
+		return NULL;
+	if (node->text != NULL) {
+		if ((n->text = (insitu && (node->borrowed & XML_BORROWED_TEXT) ? node->text : _arena_strdup(arena, node->text))) == NULL)
+			return NULL;
+		n->len_text = sx_strlen(n->text);
+	}
+	if (node->n_attributes > 0) {
+		n->attributes = (XMLAttribute*)__malloc(node->n_attributes * sizeof(XMLAttribute));
+		if (n->attributes == NULL)
+			return NULL;
+		n->n_attributes = n->sz_attributes = node->n_attributes;
+		for (i = 0; i < node->n_attributes; i++) {
+			n->attributes[i].active = node->attributes[i].active;
+			n->attributes[i].name = (borrow_attributes ? node->attributes[i].name : _arena_strdup(arena, node->attributes[i].name));
+			n->attributes[i].value = (borrow_attributes ? node->attributes[i].value : _arena_strdup(arena, node->attributes[i].value));
+			if (n->attributes[i].name == NULL || n->attributes[i].value == NULL) {
+				__free(n->attributes);
+				return NULL;
+			}
+		}
+	}
+	n->tag_type = node->tag_type;
+	n->user = node->user;
+	n->active = node->active;
+
+	return n;
+}
+
+/*
+ Duplicate 'node' (without children) with its tag and attribute strings packed in a single
+ allocation owned by the new node as its tag, instead of one allocation per string.
+ */
+static XMLNode* _XMLNode_dup_packed(const XMLNode* node)
+{
+	XMLNode* n;
+	SXML_CHAR* p;
+	size_t len, len_tag = sx_strlen(node->tag) + 1;
+	int i;
+
+	for (len = len_tag, i = 0; i < node->n_attributes; i++)
+		len += sx_strlen(node->attributes[i].name) + sx_strlen(node->attributes[i].value) + 2;
+	if ((n = XMLNode_allocN(1)) == NULL)
+		return NULL;
+	if ((n->tag = (SXML_CHAR*)__malloc(len * sizeof(SXML_CHAR))) == NULL
+		|| (node->text != NULL && (n->text = sx_strdup(node->text)) == NULL)
+		|| (node->n_attributes > 0 && (n->attributes = (XMLAttribute*)__malloc(node->n_attributes * sizeof(XMLAttribute))) == NULL)) {
+		(void)XMLNode_delete(n);
+		return NULL;
+	}
+	if (n->text != NULL)
+		n->len_text = sx_strlen(n->text);
+	memcpy(n->tag, node->tag, len_tag * sizeof(SXML_CHAR));
+	p = n->tag + len_tag;
+	for (i = 0; i < node->n_attributes; i++) {
+		len = sx_strlen(node->attributes[i].name) + 1;
+		memcpy(p, node->attributes[i].name, len * sizeof(SXML_CHAR));
+		n->attributes[i].name = p;
+		p += len;
+		len = sx_strlen(node->attributes[i].value) + 1;
+		memcpy(p, node->attributes[i].value, len * sizeof(SXML_CHAR));
+		n->attributes[i].value = p;
+		p += len;
+		n->attributes[i].active = node->attributes[i].active;
+	}
+	n->n_attributes = n->sz_attributes = node->n_attributes;
+	if (n->n_attributes > 0)
+		n->borrowed = XML_BORROWED_ATTRIBUTES | XML_PACKED_ATTRIBUTES;
+	n->tag_type = node->tag_type;
+	n->user = node->user;
+	n->active = node->active;
+
+	return n;
+}
+
+int DOMXMLDoc_node_start(const XMLNode* node, SAX_Data* sd)
+{
+	DOM_through_SAX* dom = (DOM_through_SAX*)sd->user;
+	XMLNode* new_node;
+	int i;
+
+	if (dom->doc != NULL && dom->doc->arena.sz_chunk > 0)
+		new_node = _XMLNode_dup_arena(node, &dom->doc->arena, sd->insitu);
+	else if (sd->insitu && (node->borrowed & (XML_BORROWED_TAG | XML_BORROWED_ATTRIBUTES)) == (XML_BORROWED_TAG | XML_BORROWED_ATTRIBUTES))
+		new_node = _XMLNode_dup_borrowed(node);
+	else if (node->tag != NULL)
+		new_node = _XMLNode_dup_packed(node);
+	else
+		new_node = XMLNode_dup(node, true); /* No real need to put 'true' for 'XMLNode_dup', but cleaner */
+	if (new_node == NULL) goto node_start_err;
+	
+	if (dom->current == NULL) {
+		if ((i = _add_node(&dom->doc->nodes, &dom->doc->n_nodes, &dom->doc->sz_nodes, new_node)) < 0) goto node_start_err;
+
+		if (dom->doc->i_root < 0 && (node->tag_type == TAG_FATHER || node->tag_type == TAG_SELF))
+			dom->doc->i_root = i;
+	} else {
+		if ((i = _add_node(&dom->current->children, &dom->current->n_children, &dom->current->sz_children, new_node)) < 0) goto node_start_err;
+		new_node->i_child = i;
+	}
+
+	new_node->father = dom->current;
+	dom->current = new_node;
+
+	return true;
+
+node_start_err:
+	dom->error = PARSE_ERR_MEMORY;
+	dom->line_error = sd->line_num;
+	(void)XMLNode_delete(new_node);
+
+	return false;
+}
+
+int DOMXMLDoc_node_end(const XMLNode* node, SAX_Data* sd)
+{
+	DOM_through_SAX* dom = (DOM_through_SAX*)sd->user;
+
+	if (dom->current == NULL || sx_strcmp(dom->current->tag, node->tag)) {
+		sx_fprintf(stderr, C2SX("%s:%d: ERROR - End tag </%s> was unexpected"), sd->name, sd->line_num, node->tag);
+		if (dom->current != NULL)
+			sx_fprintf(stderr, C2SX(" (</%s> was expected)\n"), dom->current->tag);
+		else
+			sx_fprintf(stderr, C2SX(" (no node to end)\n"));
+
+		dom->error = PARSE_ERR_UNEXPECTED_NODE_END;
+		dom->line_error = sd->line_num;
+
+		return false;
+	}
+
+	dom->current = dom->current->father;
+
+	return true;
+}
+
+int DOMXMLDoc_node_text(SXML_CHAR* text, SAX_Data* sd)
+{
+	SXML_CHAR* p = text;
+	DOM_through_SAX* dom = (DOM_through_SAX*)sd->user;
+	XMLArena* arena = (dom->doc != NULL && dom->doc->arena.sz_chunk > 0 ? &dom->doc->arena : NULL);
+	int i;
+
+	/* Keep text, even if it is only spaces */
+#if 0
+	while(*p != NULC && sx_isspace(*p++)) ;
+	if (*p == NULC) return true; /* Only spaces */
+#endif
+
+	/* If there is no current node to add text to, raise an error, except if text is only spaces, in which case it is probably just formatting */
+	if (dom->current == NULL) {
+		while(*p != NULC && sx_isspace(*p++)) ;
+		if (*p == NULC) /* Only spaces => probably pretty-printing */
+			return true;
+		dom->error = PARSE_ERR_TEXT_OUTSIDE_NODE;
+		dom->line_error = sd->line_num;
+		return false; /* There is some "real" text => raise an error */
+	}
+
+	if (dom->text_as_nodes) {
+		XMLNode text_node;
+		XMLNode* new_node;
+		if (arena != NULL) {
+			text_node.init_value = 0;
+			(void)XMLNode_init(&text_node);
+			text_node.text = text;
+			text_node.borrowed = XML_BORROWED_TEXT;
+			new_node = _XMLNode_dup_arena(&text_node, arena, sd->insitu);
+		} else {
+			new_node = XMLNode_allocN(1);
+			if (new_node != NULL && sd->insitu) {
+				new_node->text = text;
+				new_node->borrowed = XML_BORROWED_TEXT;
+			}
+		}
+		if (new_node == NULL || (new_node->text == NULL && (new_node->text = sx_strdup(text)) == NULL)
+			|| (i = _add_node(&dom->current->children, &dom->current->n_children, &dom->current->sz_children, new_node)) < 0) {
+			dom->error = PARSE_ERR_MEMORY;
+			dom->line_error = sd->line_num;
+			(void)XMLNode_delete(new_node);
+			return false;
+		}
+		new_node->tag_type = TAG_TEXT;
+		new_node->len_text = sx_strlen(new_node->text);
+		new_node->father = dom->current;
+		new_node->i_child = i;
+		//dom->current->tag_type = TAG_FATHER; // OS: should parent field be forced to be TAG_FATHER? now it has at least one TAG_TEXT child. I decided not to enforce this to enforce backward-compatibility related to tag_types
+		return true;
+	} else { /* Old behaviour: concatenate text to the previous one */
+		if (dom->current->text == NULL) {
+			if (sd->insitu) {
+				dom->current->text = text;
+				dom->current->len_text = sx_strlen(text);
+				dom->current->borrowed |= XML_BORROWED_TEXT;
+				return true;
+			}
+			if (arena != NULL) {
+				if ((dom->current->text = _arena_strdup(arena, text)) == NULL)
+					goto node_text_err;
+				dom->current->len_text = sx_strlen(text);
+				dom->current->borrowed |= XML_BORROWED_TEXT;
+				return true;
+			}
+		}
+		/* Texts appended to are moved out of the buffer or arena, and grow geometrically */
+		if (!_XMLNode_append_text(dom->current, text))
+			goto node_text_err;
+	}
+
+	return true;
+
+node_text_err:
+	dom->error = PARSE_ERR_MEMORY;
+	dom->line_error = sd->line_num;
+
+	return false;
+}
+
+int DOMXMLDoc_parse_error(ParseError error_num, int line_number, SAX_Data* sd)
+{
+	DOM_through_SAX* dom = (DOM_through_SAX*)sd->user;
+
+	dom->error = error_num;
+	dom->line_error = line_number;
+
+	/* Complete error message will be displayed in 'DOMXMLDoc_doc_end' callback */
+
+	return false; /* Stop on error */
+}
+
+/*
+ Name of 'error' in loading error messages.
+ */
+static const SXML_CHAR* _parse_error_name(ParseError error)
+{
+	switch (error) {
+		case PARSE_ERR_MEMORY:				return C2SX("MEMORY");
+		case PARSE_ERR_UNEXPECTED_TAG_END:	return C2SX("UNEXPECTED_TAG_END");
+		case PARSE_ERR_SYNTAX:				return C2SX("SYNTAX");
+		case PARSE_ERR_EOF:					return C2SX("UNEXPECTED_END_OF_FILE");
+		case PARSE_ERR_TEXT_OUTSIDE_NODE:	return C2SX("TEXT_OUTSIDE_NODE");
+		case PARSE_ERR_UNEXPECTED_NODE_END:	return C2SX("UNEXPECTED_NODE_END");
+		case PARSE_ERR_LIMIT:				return C2SX("LIMIT_EXCEEDED");
+		case PARSE_ERR_READ:				return C2SX("READ");
+		default:							return C2SX("UNKNOWN");
+	}
+}
+
+int DOMXMLDoc_doc_end(SAX_Data* sd)
+{
+	DOM_through_SAX* dom = (DOM_through_SAX*)sd->user;
+
+	if (dom->error != PARSE_ERR_NONE) {
+		sx_fprintf(stderr, C2SX("%s:%d: An error was found (%s), loading aborted...\n"), sd->name, dom->line_error, _parse_error_name(dom->error));
+		dom->current = NULL;
+		(void)XMLDoc_free(dom->doc);
+		dom->doc = NULL;
+	}
+
+	return true;
+}
+
+int SAX_Callbacks_init_DOM(SAX_Callbacks* sax)
+{
+	if (sax == NULL)
+		return false;
+
+	sax->start_doc = DOMXMLDoc_doc_start;
+	sax->start_node = DOMXMLDoc_node_start;
+	sax->end_node = DOMXMLDoc_node_end;
+	sax->new_text = DOMXMLDoc_node_text;
+	sax->on_error = DOMXMLDoc_parse_error;
+	sax->end_doc = DOMXMLDoc_doc_end;
+	sax->all_event = NULL;
+
+	return true;
+}
+
+/*
+ Open 'filename' to be parsed, skipping its BOM in Unicode.
+ Return the file, or NULL if it could not be opened.
+ */
+static FILE* _fopen_parse(const SXML_CHAR* filename)
+{
+	FILE* f;
+	SXML_CHAR* fmode = 
+#ifndef SXMLC_UNICODE
+	C2SX("rt");
+#else
+	C2SX("rb"); /* In Unicode, open the file as binary so that further 'fgetwc' read all bytes */
+	BOM_TYPE bom;
+#endif
+
+	f = sx_fopen(filename, fmode);
+	if (f == NULL)
+		return NULL;
+	/* Microsoft' 'ftell' returns invalid position for Unicode text files
+	   (see http://connect.microsoft.com/VisualStudio/feedback/details/369265/ftell-ftell-nolock-incorrectly-handling-unicode-text-translation)
+	   However, we're opening the file as binary in Unicode so we don't fall into that case...
+	*/
+	#if defined(SXMLC_UNICODE) && (defined(WIN32) || defined(WIN64))
+	//setvbuf(f, NULL, _IONBF, 0);
+	#endif
+
+#ifdef SXMLC_UNICODE
+	bom = freadBOM(f, NULL, NULL); /* Skip BOM, if any */
+	/* In Unicode, re-open the file in text-mode if there is no BOM (or UTF-8) as we assume that
+	   the file is "plain" text (i.e. 1 byte = 1 character). If opened in binary mode, 'fgetwc'
+	   would read 2 bytes for 1 character, which would not work on "plain" files. */
+	if (bom == BOM_NONE || bom == BOM_UTF_8) {
+		sx_fclose(f);
+		f = sx_fopen(filename, C2SX("rt"));
+		if (f == NULL)
+			return NULL;
+		if (bom == BOM_UTF_8)
+			freadBOM(f, NULL, NULL); /* Skip the UTF-8 BOM that was found */
+	}
+#endif
+
+	return f;
+}
+
+int XMLDoc_parse_file_SAX(const SXML_CHAR* filename, const SAX_Callbacks* sax, void* user)
+{
+	return XMLDoc_parse_file_SAX_ctx(filename, sax, user, NULL);
+}
+
+int XMLDoc_parse_file_SAX_ctx(const SXML_CHAR* filename, const SAX_Callbacks* sax, void* user, const XMLContext* ctx)
+{
+	FILE* f;
+	int ret;
+	SAX_Data sd;
+	DataSourceBlock ds;
+
+	if (sax == NULL || filename == NULL || filename[0] == NULC || (ctx != NULL && ctx->init_value != XML_INIT_DONE))
+		return false;
+
+	if ((f = _fopen_parse(filename)) == NULL)
+		return false;
+	sd.name = (SXML_CHAR*)filename;
+	sd.user = user;
+	sd.insitu = false;
+	if (!DataSourceBlock_init(&ds, (void*)f, DATA_SOURCE_FILE, 0)) {
+		(void)sx_fclose(f);
+		return false;
+	}
+	ret = _parse_data_SAX(&ds, sax, &sd, ctx != NULL ? ctx : &_default_ctx);
+	(void)DataSourceBlock_free(&ds);
+	(void)sx_fclose(f);
+
+	return ret;
+}
+
+int XMLDoc_parse_buffer_SAX(const SXML_CHAR* buffer, const SXML_CHAR* name, const SAX_Callbacks* sax, void* user)
+{
+	DataSourceBuffer dsb = { buffer, 0, 0 };
+	DataSourceBlock ds;
+	SAX_Data sd;
+	int ret;
+
+	if (sax == NULL || buffer == NULL)
+		return false;
+
+	sd.name = name;
+	sd.user = user;
+	sd.insitu = false;
+	if (!DataSourceBlock_init(&ds, (void*)&dsb, DATA_SOURCE_BUFFER, 0))
+		return false;
+	ret = _parse_data_SAX(&ds, sax, &sd, &_default_ctx);
+	(void)DataSourceBlock_free(&ds);
+
+	return ret;
+}
+
+int XMLDoc_parse_buffer_insitu_SAX(SXML_CHAR* buffer, const SXML_CHAR* name, const SAX_Callbacks* sax, void* user)
+{
+	SAX_Data sd;
+
+	if (sax == NULL || buffer == NULL)
+		return false;
+
+	sd.name = name;
+	sd.user = user;
+	sd.insitu = true;
+
+	return _parse_view_SAX(buffer, sx_strlen(buffer), NULL, sax, &sd);
+}
+
+int XMLDoc_parse_buffer_SAX_view(const SXML_CHAR* buffer, const SXML_CHAR* name, const SAX_View_Callbacks* sax, void* user)
+{
+	SAX_Data sd;
+
+	if (sax == NULL || buffer == NULL)
+		return false;
+
+	sd.name = name;
+	sd.user = user;
+	sd.insitu = false;
+
+	return _parse_view_SAX(buffer, sx_strlen(buffer), sax, NULL, &sd);
+}
+
+/*
+ Parse the 'len' characters of 'buf', which does not need to be NUL-terminated, with the context 'ctx'.
+ */
+static int _parse_mem_SAX(const SXML_CHAR* buf, size_t len, const SAX_Callbacks* sax, SAX_Data* sd, const XMLContext* ctx)
+{
+	DataSourceBlock ds;
+
+	ds.in = NULL;
+	ds.in_type = DATA_SOURCE_BUFFER;
+	ds.blk = (SXML_CHAR*)buf;
+	ds.sz_blk = 0;
+	ds.len = len;
+	ds.pos = 0;
+	ds.eos = true;
+	ds.error = false;
+
+	return _parse_data_SAX(&ds, sax, sd, ctx);
+}
+
+int XMLDoc_parse_buffer_len_SAX(const SXML_CHAR* buffer, size_t len, const SXML_CHAR* name, const SAX_Callbacks* sax, void* user)
+{
+	return XMLDoc_parse_buffer_len_SAX_ctx(buffer, len, name, sax, user, NULL);
+}
+
+int XMLDoc_parse_buffer_len_SAX_ctx(const SXML_CHAR* buffer, size_t len, const SXML_CHAR* name, const SAX_Callbacks* sax, void* user, const XMLContext* ctx)
+{
+	SAX_Data sd;
+
+	if (sax == NULL || buffer == NULL || (ctx != NULL && ctx->init_value != XML_INIT_DONE))
+		return false;
+
+	sd.name = name;
+	sd.user = user;
+	sd.insitu = false;
+
+	return _parse_mem_SAX(buffer, len, sax, &sd, ctx != NULL ? ctx : &_default_ctx);
+}
+
+int XMLDoc_parse_source_SAX(XMLDataSource* src, const SXML_CHAR* name, const SAX_Callbacks* sax, void* user)
+{
+	return XMLDoc_parse_source_SAX_ctx(src, name, sax, user, NULL);
+}
+
+int XMLDoc_parse_source_SAX_ctx(XMLDataSource* src, const SXML_CHAR* name, const SAX_Callbacks* sax, void* user, const XMLContext* ctx)
+{
+	DataSourceBlock ds;
+	SAX_Data sd;
+	int ret;
+
+	if (sax == NULL || src == NULL || (ctx != NULL && ctx->init_value != XML_INIT_DONE))
+		return false;
+
+	sd.name = name;
+	sd.user = user;
+	sd.insitu = false;
+	if (!DataSourceBlock_init(&ds, (void*)src, DATA_SOURCE_CUSTOM, 0))
+		return false;
+	ret = _parse_data_SAX(&ds, sax, &sd, ctx != NULL ? ctx : &_default_ctx);
+	(void)DataSourceBlock_free(&ds);
+
+	return ret;
+}
+
+/*
+ File mapped read-only in memory.
+ */
+typedef struct _MappedFile {
+	const unsigned char* data;	/* Mapped file content */
+	size_t size;				/* Number of bytes in 'data' */
+#if defined(SXMLC_NO_MMAP)
+#elif defined(WIN32) || defined(WIN64)
+	HANDLE hfile;
+	HANDLE hmap;
+#endif
+} MappedFile;
+
+/*
+ Map 'filename' in memory, hinting the system that it will be read sequentially.
+ When 'SXMLC_NO_MMAP' is defined, the file is read into an allocated buffer instead.
+ Return 'false' if the file could not be opened or mapped.
+ */
+static int _map_file(const SXML_CHAR* filename, MappedFile* mf)
+{
+#if defined(SXMLC_NO_MMAP)
+	FILE* f;
+	long sz;
+	unsigned char* p;
+
+	mf->data = NULL;
+	mf->size = 0;
+	f = sx_fopen(filename, C2SX("rb"));
+	if (f == NULL)
+		return false;
+	if (fseek(f, 0, SEEK_END) != 0 || (sz = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) != 0) {
+		(void)sx_fclose(f);
+		return false;
+	}
+	p = (unsigned char*)__malloc(sz > 0 ? sz : 1);
+	if (p == NULL || fread(p, 1, sz, f) != (size_t)sz) {
+		if (p != NULL)
+			__free(p);
+		(void)sx_fclose(f);
+		return false;
+	}
+	(void)sx_fclose(f);
+	mf->data = p;
+	mf->size = (size_t)sz;
+
+	return true;
+#elif defined(WIN32) || defined(WIN64)
+	LARGE_INTEGER sz;
+
+	mf->data = NULL;
+	mf->size = 0;
+	mf->hmap = NULL;
+#ifdef SXMLC_UNICODE
+	mf->hfile = CreateFileW(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+#else
+	mf->hfile = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+#endif
+	if (mf->hfile == INVALID_HANDLE_VALUE)
+		return false;
+	if (!GetFileSizeEx(mf->hfile, &sz) || (unsigned long long)sz.QuadPart > (size_t)-1) {
+		CloseHandle(mf->hfile);
+		return false;
+	}
+	mf->size = (size_t)sz.QuadPart;
+	if (mf->size == 0) /* Empty files cannot be mapped */
+		return true;
+	mf->hmap = CreateFileMapping(mf->hfile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mf->hmap == NULL) {
+		CloseHandle(mf->hfile);
+		return false;
+	}
+	mf->data = (const unsigned char*)MapViewOfFile(mf->hmap, FILE_MAP_READ, 0, 0, 0);
+	if (mf->data == NULL) {
+		CloseHandle(mf->hmap);
+		CloseHandle(mf->hfile);
+		return false;
+	}
+
+	return true;
+#else
+	struct stat st;
+	void* p;
+	int fd;
+#ifdef SXMLC_UNICODE
+	char fname[SXMLC_MAX_PATH * 4];
+
+	if (wcstombs(fname, filename, sizeof(fname)) == (size_t)-1)
+		return false;
+	fname[sizeof(fname) - 1] = '\0';
+#else
+	const char* fname = filename;
+#endif
+
+	mf->data = NULL;
+	mf->size = 0;
+	fd = open(fname, O_RDONLY);
+	if (fd < 0)
+		return false;
+	if (fstat(fd, &st) != 0 || (unsigned long long)st.st_size > (size_t)-1) {
+		(void)close(fd);
+		return false;
+	}
+	mf->size = (size_t)st.st_size;
+	if (mf->size == 0) { /* Empty files cannot be mapped */
+		(void)close(fd);
+		return true;
+	}
+	p = mmap(NULL, mf->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	(void)close(fd); /* The mapping stays valid after the file is closed */
+	if (p == MAP_FAILED)
+		return false;
+	(void)posix_madvise(p, mf->size, POSIX_MADV_SEQUENTIAL);
+	(void)posix_madvise(p, mf->size, POSIX_MADV_WILLNEED);
+	mf->data = (const unsigned char*)p;
+
+	return true;
+#endif
+}
+
+static void _unmap_file(MappedFile* mf)
+{
+#if defined(SXMLC_NO_MMAP)
+	if (mf->data != NULL)
+		__free((void*)mf->data);
+#elif defined(WIN32) || defined(WIN64)
+	if (mf->data != NULL)
+		UnmapViewOfFile(mf->data);
+	if (mf->hmap != NULL)
+		CloseHandle(mf->hmap);
+	CloseHandle(mf->hfile);
+#else
+	if (mf->data != NULL)
+		(void)munmap((void*)mf->data, mf->size);
+#endif
+	mf->data = NULL;
+	mf->size = 0;
+}
+
+#ifdef SXMLC_UNICODE
+/*
+ Detect a potential BOM at the beginning of 'data' (of 'size' bytes), the same way 'freadBOM'
+ does on files.
+ */
+static BOM_TYPE _memBOM(const unsigned char* data, size_t size, unsigned char* bom, int* sz_bom)
+{
+	BOM_TYPE type = BOM_NONE;
+	int n = 0;
+
+	if (size >= 4 && data[0] == 0x00 && data[1] == 0x00 && data[2] == 0xfe && data[3] == 0xff) {
+		type = BOM_UTF_32BE;
+		n = 4;
+	} else if (size >= 4 && data[0] == 0xff && data[1] == 0xfe && data[2] == 0x00 && data[3] == 0x00) {
+		type = BOM_UTF_32LE;
+		n = 4;
+	} else if (size >= 3 && data[0] == 0xef && data[1] == 0xbb && data[2] == 0xbf) {
+		type = BOM_UTF_8;
+		n = 3;
+	} else if (size >= 2 && data[0] == 0xfe && data[1] == 0xff) {
+		type = BOM_UTF_16BE;
+		n = 2;
+	} else if (size >= 2 && data[0] == 0xff && data[1] == 0xfe) {
+		type = BOM_UTF_16LE;
+		n = 2;
+	}
+	if (bom != NULL) {
+		memcpy(bom, data, n);
+		bom[n] = '\0';
+	}
+	if (sz_bom != NULL)
+		*sz_bom = n;
+
+	return type;
+}
+
+/*
+ Convert the mapped file 'data' (of 'size' bytes) of encoding 'bom' to wide characters.
+ If the file encoding matches 'wchar_t', the mapping is used directly and '*wbuf' is
+ set to NULL. Otherwise, '*wbuf' is allocated and should be freed by the caller.
+ Return 'false' on memory or decoding error.
+ */
+static int _map_to_wide(const unsigned char* data, size_t size, BOM_TYPE bom, int sz_bom, const SXML_CHAR** str, size_t* len, SXML_CHAR** wbuf)
+{
+	size_t i, n, unit;
+	int big_endian;
+	const unsigned int one = 1;
+
+	data += sz_bom;
+	size -= sz_bom;
+	*wbuf = NULL;
+
+	if (bom == BOM_NONE || bom == BOM_UTF_8) { /* Multibyte text, as read by 'fgetwc' on a text file */
+		mbstate_t mbs;
+		size_t rc;
+
+		*wbuf = (SXML_CHAR*)__malloc((size + 1) * sizeof(SXML_CHAR));
+		if (*wbuf == NULL)
+			return false;
+		memset(&mbs, 0, sizeof(mbs));
+		for (i = n = 0; i < size; n++) {
+			rc = mbrtowc(&(*wbuf)[n], (const char*)&data[i], size - i, &mbs);
+			if (rc == (size_t)-1 || rc == (size_t)-2) { /* Invalid or incomplete sequence: do not parse only the beginning */
+				__free(*wbuf);
+				*wbuf = NULL;
+				return false;
+			}
+			i += (rc == 0 ? 1 : rc);
+		}
+		*str = *wbuf;
+		*len = n;
+		return true;
+	}
+
+	unit = (bom == BOM_UTF_16BE || bom == BOM_UTF_16LE ? 2 : 4);
+	big_endian = (bom == BOM_UTF_16BE || bom == BOM_UTF_32BE);
+	n = size / unit;
+	if (unit == sizeof(wchar_t) && big_endian == (*(const unsigned char*)&one == 0)) { /* Use the mapping directly */
+		*str = (const SXML_CHAR*)data;
+		*len = n;
+		return true;
+	}
+
+	*wbuf = (SXML_CHAR*)__malloc((n + 1) * sizeof(SXML_CHAR));
+	if (*wbuf == NULL)
+		return false;
+	for (i = 0; i < n; i++) {
+		const unsigned char* p = &data[i * unit];
+		unsigned long c;
+		if (unit == 2)
+			c = big_endian ? ((unsigned long)p[0] << 8) | p[1] : ((unsigned long)p[1] << 8) | p[0];
+		else
+			c = big_endian ? ((unsigned long)p[0] << 24) | ((unsigned long)p[1] << 16) | ((unsigned long)p[2] << 8) | p[3]
+				: ((unsigned long)p[3] << 24) | ((unsigned long)p[2] << 16) | ((unsigned long)p[1] << 8) | p[0];
+		(*wbuf)[i] = (SXML_CHAR)c;
+	}
+	*str = *wbuf;
+	*len = n;
+
+	return true;
+}
+#endif
+
+/*
+ Map 'filename' and give its characters in '*str' and '*len'. In Unicode, they are converted to
+ wide characters in '*wbuf' when needed (NULL otherwise) and the file BOM is stored in 'doc' if not NULL.
+ Release with '_unmap_text'.
+ Return 'false' if the file could not be mapped or converted.
+ */
+static int _map_text(const SXML_CHAR* filename, MappedFile* mf, XMLDoc* doc, const SXML_CHAR** str, size_t* len, SXML_CHAR** wbuf)
+{
+#ifdef SXMLC_UNICODE
+	BOM_TYPE bom;
+	int sz_bom;
+#endif
+
+	if (!_map_file(filename, mf))
+		return false;
+
+#ifdef SXMLC_UNICODE
+	if (doc != NULL) {
+		bom = doc->bom_type = _memBOM(mf->data, mf->size, doc->bom, &doc->sz_bom);
+		sz_bom = doc->sz_bom;
+	} else
+		bom = _memBOM(mf->data, mf->size, NULL, &sz_bom);
+	if (!_map_to_wide(mf->data, mf->size, bom, sz_bom, str, len, wbuf)) {
+		_unmap_file(mf);
+		return false;
+	}
+#else
+	(void)doc;
+	*str = (mf->data != NULL ? (const SXML_CHAR*)mf->data : C2SX("")); /* Empty files are not mapped */
+	*len = mf->size;
+	*wbuf = NULL;
+#endif
+
+	return true;
+}
+
+static void _unmap_text(MappedFile* mf, SXML_CHAR* wbuf)
+{
+	if (wbuf != NULL)
+		__free(wbuf);
+	_unmap_file(mf);
+}
+
+/*
+ Map 'filename' and parse it with SAX callbacks 'sax', or view callbacks 'vsax' if 'sax' is NULL.
+ In Unicode, the file BOM is stored in 'doc' if not NULL.
+ */
+static int _parse_mmap_SAX(const SXML_CHAR* filename, const SAX_Callbacks* sax, const SAX_View_Callbacks* vsax, SAX_Data* sd, XMLDoc* doc)
+{
+	MappedFile mf;
+	const SXML_CHAR* str;
+	size_t len;
+	SXML_CHAR* wbuf;
+	int ret;
+
+	if (!_map_text(filename, &mf, doc, &str, &len, &wbuf))
+		return false;
+	ret = (sax != NULL ? _parse_mem_SAX(str, len, sax, sd, &_default_ctx) : _parse_view_SAX(str, len, vsax, NULL, sd));
+	_unmap_text(&mf, wbuf);
+
+	return ret;
+}
+
+int XMLDoc_parse_mmap_SAX(const SXML_CHAR* filename, const SAX_Callbacks* sax, void* user)
+{
+	SAX_Data sd;
+
+	if (sax == NULL || filename == NULL || filename[0] == NULC)
+		return false;
+
+	sd.name = filename;
+	sd.user = user;
+	sd.insitu = false;
+
+	return _parse_mmap_SAX(filename, sax, NULL, &sd, NULL);
+}
+
+int XMLDoc_parse_mmap_SAX_view(const SXML_CHAR* filename, const SAX_View_Callbacks* sax, void* user)
+{
+	SAX_Data sd;
+
+	if (sax == NULL || filename == NULL || filename[0] == NULC)
+		return false;
+
+	sd.name = filename;
+	sd.user = user;
+	sd.insitu = false;
+
+	return _parse_mmap_SAX(filename, NULL, sax, &sd, NULL);
+}
+
+/* Events left to give for the last text and tag found by the reader tokenizer */
+#define READER_TEXT	0x01
+#define READER_TAG	0x02
+#define READER_END	0x04	/* End of a node other than 'TAG_FATHER', after its start */
+
+static void _XMLReader_init(XMLReader* reader, FILE* f, const SXML_CHAR* name)
+{
+	reader->f = f;
+	reader->name = name;
+	reader->line_num = 1;
+	reader->n_open = 0;
+	reader->depth = 0;
+	reader->step = 0;
+	reader->event = XML_EVENT_START_DOC;
+	reader->error = PARSE_ERR_NONE;
+	reader->init_value = XML_INIT_DONE;
+}
+
+int XMLReader_open_file(XMLReader* reader, const SXML_CHAR* filename)
+{
+	FILE* f;
+
+	if (reader == NULL || filename == NULL || filename[0] == NULC)
+		return false;
+
+	if ((f = _fopen_parse(filename)) == NULL)
+		return false;
+	if (!DataSourceBlock_init(&reader->ds, (void*)f, DATA_SOURCE_FILE, 0)) {
+		(void)sx_fclose(f);
+		return false;
+	}
+	_tok_init(&reader->tok, NULL, 0, &_default_ctx);
+	_XMLReader_init(reader, f, filename);
+
+	return true;
+}
+
+int XMLReader_open_buffer(XMLReader* reader, const SXML_CHAR* buffer, const SXML_CHAR* name)
+{
+	if (reader == NULL || buffer == NULL)
+		return false;
+
+	_tok_init(&reader->tok, (SXML_CHAR*)buffer, sx_strlen(buffer), &_default_ctx);
+	_XMLReader_init(reader, NULL, name);
+
+	return true;
+}
+
+int XMLReader_close(XMLReader* reader)
+{
+	if (reader == NULL || reader->init_value != XML_INIT_DONE)
+		return false;
+
+	_tok_free(&reader->tok);
+	if (reader->f != NULL) {
+		(void)DataSourceBlock_free(&reader->ds);
+		(void)sx_fclose(reader->f);
+		reader->f = NULL;
+	}
+	reader->init_value = 0;
+
+	return true;
+}
+
+XMLEvent XMLReader_next(XMLReader* reader)
+{
+	XMLTokenizer* tok;
+	SXML_CHAR* p;
+	TagType tag_type;
+	int n_lines;
+
+	if (reader == NULL || reader->init_value != XML_INIT_DONE)
+		return XML_EVENT_ERROR;
+	if (reader->event == XML_EVENT_END_DOC || reader->event == XML_EVENT_ERROR)
+		return reader->event;
+
+	tok = &reader->tok;
+	while (reader->step == 0) {
+		tag_type = _tok_next(tok, &n_lines);
+		reader->line_num += n_lines;
+		if (tag_type > TAG_PARTIAL)
+			reader->step = (tok->text.len > 0 ? READER_TEXT : 0) | READER_TAG
+				| (tag_type != TAG_FATHER && tag_type != TAG_END ? READER_END : 0);
+		else if (tag_type != TAG_PARTIAL) {
+			reader->error = tok->error;
+			return (reader->event = XML_EVENT_ERROR);
+		} else if (tok->eos)
+			return (reader->event = XML_EVENT_END_DOC);
+		else { /* Read the next block from the file */
+			if ((p = _tok_reserve(tok, reader->ds.sz_blk)) == NULL) {
+				reader->error = PARSE_ERR_MEMORY;
+				return (reader->event = XML_EVENT_ERROR);
+			}
+			tok->len += _blkread(&reader->ds, p, reader->ds.sz_blk);
+			if (reader->ds.error) {
+				reader->error = PARSE_ERR_READ;
+				return (reader->event = XML_EVENT_ERROR);
+			}
+			tok->eos = _blkeob(&reader->ds);
+		}
+	}
+
+	reader->depth = reader->n_open;
+	if (reader->step & READER_TEXT) {
+		reader->step &= ~READER_TEXT;
+		return (reader->event = XML_EVENT_TEXT);
+	}
+	if (reader->step & READER_TAG) {
+		reader->step &= ~READER_TAG;
+		if (tok->tv.tag_type == TAG_END) {
+			if (reader->n_open > 0)
+				reader->n_open--;
+			reader->depth = reader->n_open;
+			return (reader->event = XML_EVENT_END_NODE);
+		}
+		if (tok->tv.tag_type == TAG_FATHER)
+			reader->n_open++;
+		return (reader->event = XML_EVENT_START_NODE);
+	}
+	reader->step = 0;
+
+	return (reader->event = XML_EVENT_END_NODE);
+}
+
+int XMLReader_skip_subtree(XMLReader* reader)
+{
+	XMLEvent event;
+	int depth;
+
+	if (reader == NULL || reader->init_value != XML_INIT_DONE || reader->event != XML_EVENT_START_NODE)
+		return false;
+
+	depth = reader->depth;
+	do {
+		event = XMLReader_next(reader);
+	} while (event != XML_EVENT_ERROR && event != XML_EVENT_END_DOC && (event != XML_EVENT_END_NODE || reader->depth != depth));
+
+	return (event == XML_EVENT_END_NODE);
+}
+
+const XMLView* XMLReader_get_tag(const XMLReader* reader)
+{
+	if (reader == NULL || reader->init_value != XML_INIT_DONE
+		|| (reader->event != XML_EVENT_START_NODE && reader->event != XML_EVENT_END_NODE))
+		return NULL;
+
+	return &reader->tok.tv.tag;
+}
+
+TagType XMLReader_get_tag_type(const XMLReader* reader)
+{
+	if (reader == NULL || reader->init_value != XML_INIT_DONE
+		|| (reader->event != XML_EVENT_START_NODE && reader->event != XML_EVENT_END_NODE))
+		return TAG_NONE;
+
+	return reader->tok.tv.tag_type;
+}
+
+int XMLReader_get_attributes(const XMLReader* reader, const XMLAttributeView** attributes)
+{
+	if (reader == NULL || reader->init_value != XML_INIT_DONE || reader->event != XML_EVENT_START_NODE)
+		return 0;
+
+	if (attributes != NULL)
+		*attributes = reader->tok.tv.attributes;
+
+	return reader->tok.tv.n_attributes;
+}
+
+const XMLView* XMLReader_get_attribute(const XMLReader* reader, const SXML_CHAR* name)
+{
+	const XMLAttributeView* attr;
+	size_t len;
+	int i;
+
+	if (reader == NULL || reader->init_value != XML_INIT_DONE || reader->event != XML_EVENT_START_NODE || name == NULL)
+		return NULL;
+
+	len = sx_strlen(name);
+	for (i = 0, attr = reader->tok.tv.attributes; i < reader->tok.tv.n_attributes; i++, attr++)
+		if (attr->name.len == len && !sx_strncmp(attr->name.ptr, name, len))
+			return &attr->value;
+
+	return NULL;
+}
+
+const XMLView* XMLReader_get_text(const XMLReader* reader)
+{
+	if (reader == NULL || reader->init_value != XML_INIT_DONE || reader->event != XML_EVENT_TEXT)
+		return NULL;
+
+	return &reader->tok.text;
+}
+
+int XMLReader_get_depth(const XMLReader* reader)
+{
+	return (reader == NULL || reader->init_value != XML_INIT_DONE ? 0 : reader->depth);
+}
+
+int XMLReader_get_line(const XMLReader* reader)
+{
+	return (reader == NULL || reader->init_value != XML_INIT_DONE ? 0 : reader->line_num);
+}
+
+ParseError XMLReader_get_error(const XMLReader* reader)
+{
+	return (reader == NULL || reader->init_value != XML_INIT_DONE ? PARSE_ERR_NONE : reader->error);
+}
+
+/*
+ Load 'filename' into 'dom->doc' with the context 'ctx', the doc being freed on error.
+ */
+static int _parse_file_DOM(const SXML_CHAR* filename, DOM_through_SAX* dom, const XMLContext* ctx)
+{
+	XMLDoc* doc = dom->doc;
+	SAX_Callbacks sax;
+
+	sx_strncpy(doc->filename, filename, SXMLC_MAX_PATH - 1);
+	doc->filename[SXMLC_MAX_PATH - 1] = NULC;
+
+	/* Read potential BOM on file, only when unicode is defined */
+#ifdef SXMLC_UNICODE
+	{
+		/* In Unicode, open the file as binary so that further 'fgetwc' read all bytes */
+		FILE* f = sx_fopen(filename, C2SX("rb"));
+		if (f != NULL) {
+			#if defined(SXMLC_UNICODE) && (defined(WIN32) || defined(WIN64))
+			//setvbuf(f, NULL, _IONBF, 0);
+			#endif
+			doc->bom_type = freadBOM(f, doc->bom, &doc->sz_bom);
+			sx_fclose(f);
+		}
+	}
+#endif
+
+	dom->current = NULL;
+	SAX_Callbacks_init_DOM(&sax);
+
+	if (!XMLDoc_parse_file_SAX_ctx(filename, &sax, dom, ctx)) {
+		(void)XMLDoc_free(doc);
+		return false;
+	}
+
+	return true;
+}
+
+int XMLDoc_parse_file_DOM_text_as_nodes(const SXML_CHAR* filename, XMLDoc* doc, int text_as_nodes)
+{
+	return XMLDoc_parse_file_DOM_ctx(filename, doc, text_as_nodes, NULL);
+}
+
+int XMLDoc_parse_file_DOM_ctx(const SXML_CHAR* filename, XMLDoc* doc, int text_as_nodes, const XMLContext* ctx)
+{
+	DOM_through_SAX dom;
+
+	if (doc == NULL || filename == NULL || filename[0] == NULC || doc->init_value != XML_INIT_DONE)
+		return false;
+
+	dom.doc = doc;
+	dom.text_as_nodes = text_as_nodes;
+
+	return _parse_file_DOM(filename, &dom, ctx);
+}
+
+int XMLDoc_parse_buffer_DOM_text_as_nodes(const SXML_CHAR* buffer, const SXML_CHAR* name, XMLDoc* doc, int text_as_nodes)
+{
+	DOM_through_SAX dom;
+	SAX_Callbacks sax;
+
+	if (doc == NULL || buffer == NULL || doc->init_value != XML_INIT_DONE)
+		return false;
+
+	dom.doc = doc;
+	dom.current = NULL;
+	dom.text_as_nodes = text_as_nodes;
+	SAX_Callbacks_init_DOM(&sax);
+
+	if (!XMLDoc_parse_buffer_SAX(buffer, name, &sax, &dom)) {
+		(void)XMLDoc_free(doc);
+		return false;
+	}
+
+	return true;
+}
+
+int XMLDoc_parse_buffer_len_DOM_text_as_nodes(const SXML_CHAR* buffer, size_t len, const SXML_CHAR* name, XMLDoc* doc, int text_as_nodes)
+{
+	return XMLDoc_parse_buffer_len_DOM_ctx(buffer, len, name, doc, text_as_nodes, NULL);
+}
+
+int XMLDoc_parse_buffer_len_DOM_ctx(const SXML_CHAR* buffer, size_t len, const SXML_CHAR* name, XMLDoc* doc, int text_as_nodes, const XMLContext* ctx)
+{
+	DOM_through_SAX dom;
+	SAX_Callbacks sax;
+
+	if (doc == NULL || buffer == NULL || doc->init_value != XML_INIT_DONE)
+		return false;
+
+	dom.doc = doc;
+	dom.current = NULL;
+	dom.text_as_nodes = text_as_nodes;
+	SAX_Callbacks_init_DOM(&sax);
+
+	if (!XMLDoc_parse_buffer_len_SAX_ctx(buffer, len, name, &sax, &dom, ctx)) {
+		(void)XMLDoc_free(doc);
+		return false;
+	}
+
+	return true;
+}
+
+int XMLDoc_parse_source_DOM_text_as_nodes(XMLDataSource* src, const SXML_CHAR* name, XMLDoc* doc, int text_as_nodes)
+{
+	return XMLDoc_parse_source_DOM_ctx(src, name, doc, text_as_nodes, NULL);
+}
+
+int XMLDoc_parse_source_DOM_ctx(XMLDataSource* src, const SXML_CHAR* name, XMLDoc* doc, int text_as_nodes, const XMLContext* ctx)
+{
+	DOM_through_SAX dom;
+	SAX_Callbacks sax;
+
+	if (doc == NULL || src == NULL || doc->init_value != XML_INIT_DONE)
+		return false;
+
+	dom.doc = doc;
+	dom.current = NULL;
+	dom.text_as_nodes = text_as_nodes;
+	SAX_Callbacks_init_DOM(&sax);
+
+	if (!XMLDoc_parse_source_SAX_ctx(src, name, &sax, &dom, ctx)) {
+		(void)XMLDoc_free(doc);
+		return false;
+	}
+
+	return true;
+}
+
+int XMLDoc_parse_buffer_insitu_DOM_text_as_nodes(SXML_CHAR* buffer, const SXML_CHAR* name, XMLDoc* doc, int text_as_nodes)
+{
+	DOM_through_SAX dom;
+	SAX_Callbacks sax;
+
+	if (doc == NULL || buffer == NULL || doc->init_value != XML_INIT_DONE)
+		return false;
+
+	dom.doc = doc;
+	dom.current = NULL;
+	dom.text_as_nodes = text_as_nodes;
+	SAX_Callbacks_init_DOM(&sax);
+
+	if (!XMLDoc_parse_buffer_insitu_SAX(buffer, name, &sax, &dom)) {
+		(void)XMLDoc_free(doc);
+		return false;
+	}
+
+	return true;
+}
+
+int XMLDoc_parse_mmap_DOM_text_as_nodes(const SXML_CHAR* filename, XMLDoc* doc, int text_as_nodes)
+{
+	DOM_through_SAX dom;
+	SAX_Callbacks sax;
+	SAX_Data sd;
+
+	if (doc == NULL || filename == NULL || filename[0] == NULC || doc->init_value != XML_INIT_DONE)
+		return false;
+
+	sx_strncpy(doc->filename, filename, SXMLC_MAX_PATH - 1);
+	doc->filename[SXMLC_MAX_PATH - 1] = NULC;
+
+	dom.doc = doc;
+	dom.current = NULL;
+	dom.text_as_nodes = text_as_nodes;
+	SAX_Callbacks_init_DOM(&sax);
+
+	sd.name = filename;
+	sd.user = &dom;
+	sd.insitu = false;
+	if (!_parse_mmap_SAX(filename, &sax, NULL, &sd, doc)) {
+		(void)XMLDoc_free(doc);
+		return false;
+	}
+
+	return true;
+}
+
+
+/* --- Tape documents --- */
+
+int XMLTape_init(XMLTape* tape)
+{
+	if (tape == NULL)
+		return false;
+
+	tape->nodes = NULL;
+	tape->n_nodes = 0;
+	tape->sz_nodes = 0;
+	tape->attributes = NULL;
+	tape->n_attributes = 0;
+	tape->sz_attributes = 0;
+	tape->strings = NULL;
+	tape->len_strings = 0;
+	tape->sz_strings = 0;
+	tape->i_root = -1;
+	tape->init_value = XML_INIT_DONE;
+
+	return true;
+}
+
+int XMLTape_free(XMLTape* tape)
+{
+	if (tape == NULL || tape->init_value != XML_INIT_DONE)
+		return false;
+
+	if (tape->nodes != NULL) __free(tape->nodes);
+	if (tape->attributes != NULL) __free(tape->attributes);
+	if (tape->strings != NULL) __free(tape->strings);
+
+	return XMLTape_init(tape);
+}
+
+/*
+ Append the 'len' first characters of 'str' to 'tape' strings, followed by a NUL character.
+ Return the offset of the new string, or -1 for memory error.
+ */
+static int _tape_add_string(XMLTape* tape, const SXML_CHAR* str, size_t len)
+{
+	SXML_CHAR* pt;
+	int offset = tape->len_strings;
+
+	if ((size_t)offset + len + 1 > ((unsigned int)-1 >> 2)) /* Keep room for '_grow_array' to double */
+		return -1;
+	pt = (SXML_CHAR*)_grow_array(tape->strings, &tape->sz_strings, offset + (int)len + 1, sizeof(SXML_CHAR));
+	if (pt == NULL)
+		return -1;
+	tape->strings = pt;
+	memcpy(&pt[offset], str, len * sizeof(SXML_CHAR));
+	pt[offset + len] = NULC;
+	tape->len_strings += (int)len + 1;
+
+	return offset;
+}
+
+static unsigned int _tape_hash(const SXML_CHAR* str)
+{
+	unsigned int h = 2166136261u;
+
+	for (; *str != NULC; str++)
+		h = (h ^ (unsigned int)*str) * 16777619u;
+
+	return h;
+}
+
+/*
+ Return the offset of 'name' in the strings of the tape being built, adding it only when it was
+ not added before, so that tag and attribute names are stored once.
+ Return -1 for memory error.
+ */
+static int _tape_add_name(TAPE_through_SAX* ts, const SXML_CHAR* name)
+{
+	const SXML_CHAR* strings;
+	int* pt;
+	int i, j, sz;
+
+	if (2 * (ts->n_names + 1) > ts->sz_names) { /* Keep the table at most half full */
+		sz = (ts->sz_names > 0 ? 2 * ts->sz_names : 64);
+		if ((pt = (int*)__malloc(sz * sizeof(int))) == NULL)
+			return -1;
+		for (i = 0; i < sz; i++)
+			pt[i] = -1;
+		for (i = 0; i < ts->sz_names; i++) {
+			if (ts->names[i] < 0)
+				continue;
+			for (j = _tape_hash(&ts->tape->strings[ts->names[i]]) & (sz - 1); pt[j] >= 0; j = (j + 1) & (sz - 1)) ;
+			pt[j] = ts->names[i];
+		}
+		if (ts->names != NULL)
+			__free(ts->names);
+		ts->names = pt;
+		ts->sz_names = sz;
+	}
+
+	strings = ts->tape->strings;
+	for (i = _tape_hash(name) & (ts->sz_names - 1); ts->names[i] >= 0; i = (i + 1) & (ts->sz_names - 1))
+		if (!sx_strcmp(&strings[ts->names[i]], name))
+			return ts->names[i];
+
+	if ((j = _tape_add_string(ts->tape, name, sx_strlen(name))) < 0)
+		return -1;
+	ts->names[i] = j;
+	ts->n_names++;
+
+	return j;
+}
+
+/*
+ Release the memory used while building the tape, not the tape itself.
+ */
+static void _tape_builder_free(TAPE_through_SAX* ts)
+{
+	if (ts->text != NULL) __free(ts->text);
+	if (ts->levels != NULL) __free(ts->levels);
+	if (ts->names != NULL) __free(ts->names);
+	ts->text = NULL;
+	ts->len_text = ts->sz_text = 0;
+	ts->levels = NULL;
+	ts->n_levels = ts->sz_levels = 0;
+	ts->names = NULL;
+	ts->n_names = ts->sz_names = 0;
+}
+
+static void _tape_builder_init(TAPE_through_SAX* ts, XMLTape* tape)
+{
+	ts->tape = tape;
+	ts->current = -1;
+	ts->text = NULL;
+	ts->levels = NULL;
+	ts->names = NULL;
+	_tape_builder_free(ts);
+	ts->error = PARSE_ERR_NONE;
+	ts->line_error = 0;
+}
+
+int TAPEXMLDoc_doc_start(SAX_Data* sd)
+{
+	TAPE_through_SAX* ts = (TAPE_through_SAX*)sd->user;
+
+	_tape_builder_init(ts, ts->tape);
+
+	return true;
+}
+
+int TAPEXMLDoc_node_start(const XMLNode* node, SAX_Data* sd)
+{
+	TAPE_through_SAX* ts = (TAPE_through_SAX*)sd->user;
+	XMLTape* tape = ts->tape;
+	XMLTapeNode* tn;
+	XMLTapeAttribute* ta;
+	void* pt;
+	int i;
+
+	if ((pt = _grow_array(tape->nodes, &tape->sz_nodes, tape->n_nodes + 1, sizeof(XMLTapeNode))) == NULL)
+		goto node_start_err;
+	tape->nodes = (XMLTapeNode*)pt;
+	if ((pt = _grow_array(ts->levels, &ts->sz_levels, ts->n_levels + 1, sizeof(size_t))) == NULL)
+		goto node_start_err;
+	ts->levels = (size_t*)pt;
+	if (node->n_attributes > 0) {
+		if ((pt = _grow_array(tape->attributes, &tape->sz_attributes, tape->n_attributes + node->n_attributes, sizeof(XMLTapeAttribute))) == NULL)
+			goto node_start_err;
+		tape->attributes = (XMLTapeAttribute*)pt;
+	}
+
+	tn = &tape->nodes[tape->n_nodes];
+	tn->tag_type = node->tag_type;
+	tn->text = -1;
+	tn->father = ts->current;
+	tn->end = tape->n_nodes + 1;
+	tn->attributes = tape->n_attributes;
+	tn->n_attributes = 0;
+	/* Only tag names are shared, special tags keep their content in 'tag' */
+	if (node->tag_type == TAG_FATHER || node->tag_type == TAG_SELF)
+		tn->tag = _tape_add_name(ts, node->tag);
+	else
+		tn->tag = _tape_add_string(tape, node->tag, sx_strlen(node->tag));
+	if (tn->tag < 0)
+		goto node_start_err;
+
+	for (i = 0; i < node->n_attributes; i++) {
+		if (!node->attributes[i].active)
+			continue;
+		ta = &tape->attributes[tape->n_attributes];
+		if ((ta->name = _tape_add_name(ts, node->attributes[i].name)) < 0
+			|| (ta->value = _tape_add_string(tape, node->attributes[i].value, sx_strlen(node->attributes[i].value))) < 0)
+			goto node_start_err;
+		tape->n_attributes++;
+		tn->n_attributes++;
+	}
+
+	if (ts->current < 0 && tape->i_root < 0 && (node->tag_type == TAG_FATHER || node->tag_type == TAG_SELF))
+		tape->i_root = tape->n_nodes;
+	ts->levels[ts->n_levels++] = ts->len_text;
+	ts->current = tape->n_nodes++;
+
+	return true;
+
+node_start_err:
+	ts->error = PARSE_ERR_MEMORY;
+	ts->line_error = sd->line_num;
+
+	return false;
+}
+
+int TAPEXMLDoc_node_end(const XMLNode* node, SAX_Data* sd)
+{
+	TAPE_through_SAX* ts = (TAPE_through_SAX*)sd->user;
+	XMLTape* tape = ts->tape;
+	XMLTapeNode* tn;
+	size_t start;
+
+	if (ts->current < 0 || sx_strcmp(&tape->strings[tape->nodes[ts->current].tag], node->tag)) {
+		sx_fprintf(stderr, C2SX("%s:%d: ERROR - End tag </%s> was unexpected"), sd->name, sd->line_num, node->tag);
+		if (ts->current >= 0)
+			sx_fprintf(stderr, C2SX(" (</%s> was expected)\n"), &tape->strings[tape->nodes[ts->current].tag]);
+		else
+			sx_fprintf(stderr, C2SX(" (no node to end)\n"));
+
+		ts->error = PARSE_ERR_UNEXPECTED_NODE_END;
+		ts->line_error = sd->line_num;
+
+		return false;
+	}
+
+	/* Text read while the node was opened is now complete and goes to the pool */
+	tn = &tape->nodes[ts->current];
+	start = ts->levels[--ts->n_levels];
+	if (ts->len_text > start) {
+		if ((tn->text = _tape_add_string(tape, &ts->text[start], ts->len_text - start)) < 0) {
+			ts->error = PARSE_ERR_MEMORY;
+			ts->line_error = sd->line_num;
+			return false;
+		}
+		ts->len_text = start;
+	}
+	tn->end = tape->n_nodes;
+	ts->current = tn->father;
+
+	return true;
+}
+
+int TAPEXMLDoc_node_text(SXML_CHAR* text, SAX_Data* sd)
+{
+	TAPE_through_SAX* ts = (TAPE_through_SAX*)sd->user;
+	SXML_CHAR* p = text;
+	SXML_CHAR* pt;
+	size_t len, sz;
+
+	/* As in DOM loading, only spaces are allowed outside nodes */
+	if (ts->current < 0) {
+		while (*p != NULC && sx_isspace(*p))
+			p++;
+		if (*p == NULC)
+			return true;
+		ts->error = PARSE_ERR_TEXT_OUTSIDE_NODE;
+		ts->line_error = sd->line_num;
+		return false;
+	}
+
+	/* Texts of the nodes being built are kept as a stack, the current node one being last */
+	len = sx_strlen(text);
+	if (ts->len_text + len > ts->sz_text) {
+		sz = (ts->sz_text > 0 ? 2 * ts->sz_text : 256);
+		if (sz < ts->len_text + len)
+			sz = ts->len_text + len;
+		if ((pt = (SXML_CHAR*)__realloc(ts->text, sz * sizeof(SXML_CHAR))) == NULL) {
+			ts->error = PARSE_ERR_MEMORY;
+			ts->line_error = sd->line_num;
+			return false;
+		}
+		ts->text = pt;
+		ts->sz_text = sz;
+	}
+	memcpy(&ts->text[ts->len_text], text, len * sizeof(SXML_CHAR));
+	ts->len_text += len;
+
+	return true;
+}
+
+int TAPEXMLDoc_parse_error(ParseError error_num, int line_number, SAX_Data* sd)
+{
+	TAPE_through_SAX* ts = (TAPE_through_SAX*)sd->user;
+
+	ts->error = error_num;
+	ts->line_error = line_number;
+
+	return false; /* Stop on error */
+}
+
+int TAPEXMLDoc_doc_end(SAX_Data* sd)
+{
+	TAPE_through_SAX* ts = (TAPE_through_SAX*)sd->user;
+	XMLTape* tape = ts->tape;
+
+	_tape_builder_free(ts);
+	ts->current = -1;
+
+	if (ts->error != PARSE_ERR_NONE) {
+		sx_fprintf(stderr, C2SX("%s:%d: An error was found (%s), loading aborted...\n"), sd->name, ts->line_error, _parse_error_name(ts->error));
+		(void)XMLTape_free(tape);
+		return true;
+	}
+
+	/* The tape will not grow anymore */
+	_shrink_array((void**)&tape->nodes, &tape->sz_nodes, tape->n_nodes, sizeof(XMLTapeNode));
+	_shrink_array((void**)&tape->attributes, &tape->sz_attributes, tape->n_attributes, sizeof(XMLTapeAttribute));
+	_shrink_array((void**)&tape->strings, &tape->sz_strings, tape->len_strings, sizeof(SXML_CHAR));
+
+	return true;
+}
+
+int SAX_Callbacks_init_tape(SAX_Callbacks* sax)
+{
+	if (sax == NULL)
+		return false;
+
+	sax->start_doc = TAPEXMLDoc_doc_start;
+	sax->start_node = TAPEXMLDoc_node_start;
+	sax->end_node = TAPEXMLDoc_node_end;
+	sax->new_text = TAPEXMLDoc_node_text;
+	sax->on_error = TAPEXMLDoc_parse_error;
+	sax->end_doc = TAPEXMLDoc_doc_end;
+	sax->all_event = NULL;
+
+	return true;
+}
+
+int XMLTape_parse_file(const SXML_CHAR* filename, XMLTape* tape)
+{
+	return XMLTape_parse_file_ctx(filename, tape, NULL);
+}
+
+int XMLTape_parse_file_ctx(const SXML_CHAR* filename, XMLTape* tape, const XMLContext* ctx)
+{
+	TAPE_through_SAX ts;
+	SAX_Callbacks sax;
+	int ret;
+
+	if (tape == NULL || filename == NULL || filename[0] == NULC || tape->init_value != XML_INIT_DONE)
+		return false;
+
+	_tape_builder_init(&ts, tape);
+	SAX_Callbacks_init_tape(&sax);
+
+	ret = XMLDoc_parse_file_SAX_ctx(filename, &sax, &ts, ctx);
+	_tape_builder_free(&ts); /* In case 'end_doc' was not called */
+	if (!ret)
+		(void)XMLTape_free(tape);
+
+	return ret;
+}
+
+int XMLTape_parse_buffer(const SXML_CHAR* buffer, const SXML_CHAR* name, XMLTape* tape)
+{
+	TAPE_through_SAX ts;
+	SAX_Callbacks sax;
+	int ret;
+
+	if (tape == NULL || buffer == NULL || tape->init_value != XML_INIT_DONE)
 		return false;
 
-	sax->start_doc = DOMXMLDoc_doc_start;
-	sax->start_node = DOMXMLDoc_node_start;
-	sax->end_node = DOMXMLDoc_node_end;
-	sax->new_text = DOMXMLDoc_node_text;
-	sax->on_error = DOMXMLDoc_parse_error;
-	sax->end_doc = DOMXMLDoc_doc_end;
-	sax->all_event = NULL;
+	_tape_builder_init(&ts, tape);
+	SAX_Callbacks_init_tape(&sax);
+
+	ret = XMLDoc_parse_buffer_SAX(buffer, name, &sax, &ts);
+	_tape_builder_free(&ts);
+	if (!ret)
+		(void)XMLTape_free(tape);
+
+	return ret;
+}
+
+/*
+ Return 'true' if 'i_node' is a node of 'tape'.
+ */
+static int _tape_has_node(const XMLTape* tape, int i_node)
+{
+	return tape != NULL && tape->init_value == XML_INIT_DONE && i_node >= 0 && i_node < tape->n_nodes;
+}
+
+int XMLTape_root(const XMLTape* tape)
+{
+	return (tape == NULL || tape->init_value != XML_INIT_DONE ? -1 : tape->i_root);
+}
+
+int XMLTape_father(const XMLTape* tape, int i_node)
+{
+	return (_tape_has_node(tape, i_node) ? tape->nodes[i_node].father : -1);
+}
+
+int XMLTape_first_child(const XMLTape* tape, int i_node)
+{
+	if (!_tape_has_node(tape, i_node))
+		return -1;
+
+	return (tape->nodes[i_node].end > i_node + 1 ? i_node + 1 : -1);
+}
+
+int XMLTape_next_sibling(const XMLTape* tape, int i_node)
+{
+	int i;
+
+	if (!_tape_has_node(tape, i_node) || tape->nodes[i_node].father < 0)
+		return -1;
+
+	i = tape->nodes[i_node].end;
+
+	return (i < tape->nodes[tape->nodes[i_node].father].end ? i : -1);
+}
+
+int XMLTape_prev_sibling(const XMLTape* tape, int i_node)
+{
+	int i, father;
+
+	if (!_tape_has_node(tape, i_node) || (father = tape->nodes[i_node].father) < 0)
+		return -1;
+
+	/* The node before is either the father or the last descendant of the previous sibling */
+	for (i = i_node - 1; i != father && tape->nodes[i].father != father; i = tape->nodes[i].father) ;
+
+	return (i != father ? i : -1);
+}
+
+int XMLTape_next(const XMLTape* tape, int i_node)
+{
+	if (!_tape_has_node(tape, i_node))
+		return -1;
+
+	/* Nodes following in document order are inside the same root node until a document node is found */
+	i_node++;
+
+	return (i_node < tape->n_nodes && tape->nodes[i_node].father >= 0 ? i_node : -1);
+}
+
+const SXML_CHAR* XMLTape_get_tag(const XMLTape* tape, int i_node)
+{
+	return (_tape_has_node(tape, i_node) ? &tape->strings[tape->nodes[i_node].tag] : NULL);
+}
+
+const SXML_CHAR* XMLTape_get_text(const XMLTape* tape, int i_node)
+{
+	if (!_tape_has_node(tape, i_node) || tape->nodes[i_node].text < 0)
+		return NULL;
+
+	return &tape->strings[tape->nodes[i_node].text];
+}
+
+const SXML_CHAR* XMLTape_get_attribute(const XMLTape* tape, int i_node, const SXML_CHAR* attr_name)
+{
+	const XMLTapeAttribute* attr;
+	int i;
+
+	if (!_tape_has_node(tape, i_node) || attr_name == NULL)
+		return NULL;
+
+	attr = &tape->attributes[tape->nodes[i_node].attributes];
+	for (i = 0; i < tape->nodes[i_node].n_attributes; i++)
+		if (!sx_strcmp(&tape->strings[attr[i].name], attr_name))
+			return &tape->strings[attr[i].value];
+
+	return NULL;
+}
+
+
+/* --- Threads --- */
+
+#if defined(SXMLC_NO_THREADS)
+typedef int XMLMutex;
+#elif defined(WIN32) || defined(WIN64)
+typedef CRITICAL_SECTION XMLMutex;
+#else
+typedef pthread_mutex_t XMLMutex;
+#endif
 
+static int _mutex_init(XMLMutex* m)
+{
+#if defined(SXMLC_NO_THREADS)
+	*m = 0;
+	return true;
+#elif defined(WIN32) || defined(WIN64)
+	InitializeCriticalSection(m);
 	return true;
+#else
+	return !pthread_mutex_init(m, NULL);
+#endif
 }
 
-int XMLDoc_parse_file_SAX(const SXML_CHAR* filename, const SAX_Callbacks* sax, void* user)
+static void _mutex_free(XMLMutex* m)
 {
-	FILE* f;
-	int ret;
-	SAX_Data sd;
-	SXML_CHAR* fmode = 
-#ifndef SXMLC_UNICODE
-	C2SX("rt");
+#if defined(SXMLC_NO_THREADS)
+	(void)m;
+#elif defined(WIN32) || defined(WIN64)
+	DeleteCriticalSection(m);
 #else
-	C2SX("rb"); /* In Unicode, open the file as binary so that further 'fgetwc' read all bytes */
-	BOM_TYPE bom;
+	(void)pthread_mutex_destroy(m);
 #endif
+}
 
+static void _mutex_lock(XMLMutex* m)
+{
+#if defined(SXMLC_NO_THREADS)
+	(void)m;
+#elif defined(WIN32) || defined(WIN64)
+	EnterCriticalSection(m);
+#else
+	(void)pthread_mutex_lock(m);
+#endif
+}
 
-	if (sax == NULL || filename == NULL || filename[0] == NULC)
-		return false;
+static void _mutex_unlock(XMLMutex* m)
+{
+#if defined(SXMLC_NO_THREADS)
+	(void)m;
+#elif defined(WIN32) || defined(WIN64)
+	LeaveCriticalSection(m);
+#else
+	(void)pthread_mutex_unlock(m);
+#endif
+}
 
-	f = sx_fopen(filename, fmode);
-	if (f == NULL)
-		return false;
-	/* Microsoft' 'ftell' returns invalid position for Unicode text files
-	   (see http://connect.microsoft.com/VisualStudio/feedback/details/369265/ftell-ftell-nolock-incorrectly-handling-unicode-text-translation)
-	   However, we're opening the file as binary in Unicode so we don't fall into that case...
-	*/
-	#if defined(SXMLC_UNICODE) && (defined(WIN32) || defined(WIN64))
-	//setvbuf(f, NULL, _IONBF, 0);
-	#endif
+typedef void (*THREAD_FCT)(void* arg);
 
-	sd.name = (SXML_CHAR*)filename;
-	sd.user = user;
-#ifdef SXMLC_UNICODE
-	bom = freadBOM(f, NULL, NULL); /* Skip BOM, if any */
-	/* In Unicode, re-open the file in text-mode if there is no BOM (or UTF-8) as we assume that
-	   the file is "plain" text (i.e. 1 byte = 1 character). If opened in binary mode, 'fgetwc'
-	   would read 2 bytes for 1 character, which would not work on "plain" files. */
-	if (bom == BOM_NONE || bom == BOM_UTF_8) {
-		sx_fclose(f);
-		f = sx_fopen(filename, C2SX("rt"));
-		if (f == NULL)
-			return false;
-		if (bom == BOM_UTF_8)
-			freadBOM(f, NULL, NULL); /* Skip the UTF-8 BOM that was found */
+typedef struct _XMLThread {
+	THREAD_FCT fct;
+	void* arg;
+#if defined(SXMLC_NO_THREADS)
+#elif defined(WIN32) || defined(WIN64)
+	HANDLE thread;
+#else
+	pthread_t thread;
+	int started;
+#endif
+} XMLThread;
+
+#if defined(SXMLC_NO_THREADS)
+#elif defined(WIN32) || defined(WIN64)
+static DWORD WINAPI _thread_main(LPVOID t)
+{
+	((XMLThread*)t)->fct(((XMLThread*)t)->arg);
+	return 0;
+}
+#else
+static void* _thread_main(void* t)
+{
+	((XMLThread*)t)->fct(((XMLThread*)t)->arg);
+	return NULL;
+}
+#endif
+
+/*
+ Call 'fct' on each of the 'n' arguments of 'sz_arg' bytes in 'args', concurrently, and wait for all
+ of them to return ('sz_arg' is 0 for all calls to share the same argument). The calling thread handles the first argument, as well as the ones for which a
+ thread could not be created. When 'SXMLC_NO_THREADS' is defined, they are all handled one after
+ the other by the calling thread.
+ */
+static void _run_threads(THREAD_FCT fct, void* args, size_t sz_arg, int n)
+{
+	XMLThread* th;
+	int i;
+
+	th = (n > 1 ? (XMLThread*)__calloc(n, sizeof(XMLThread)) : NULL);
+	if (th == NULL) {
+		for (i = 0; i < n; i++)
+			fct((char*)args + i * sz_arg);
+		return;
+	}
+	for (i = 0; i < n; i++) {
+		th[i].fct = fct;
+		th[i].arg = (char*)args + i * sz_arg;
+	}
+
+#if defined(SXMLC_NO_THREADS)
+	for (i = 0; i < n; i++)
+		fct(th[i].arg);
+#elif defined(WIN32) || defined(WIN64)
+	for (i = 1; i < n; i++)
+		th[i].thread = CreateThread(NULL, 0, _thread_main, &th[i], 0, NULL);
+	fct(th[0].arg);
+	for (i = 1; i < n; i++) {
+		if (th[i].thread == NULL)
+			fct(th[i].arg);
+		else {
+			(void)WaitForSingleObject(th[i].thread, INFINITE);
+			(void)CloseHandle(th[i].thread);
+		}
+	}
+#else
+	for (i = 1; i < n; i++)
+		th[i].started = !pthread_create(&th[i].thread, NULL, _thread_main, &th[i]);
+	fct(th[0].arg);
+	for (i = 1; i < n; i++) {
+		if (!th[i].started)
+			fct(th[i].arg);
+		else
+			(void)pthread_join(th[i].thread, NULL);
 	}
 #endif
-	ret = _parse_data_SAX((void*)f, DATA_SOURCE_FILE, sax, &sd);
-	(void)sx_fclose(f);
+	__free(th);
+}
 
-	return ret;
+static int _cpu_count(void)
+{
+#if defined(SXMLC_NO_THREADS)
+	return 1;
+#elif defined(WIN32) || defined(WIN64)
+	SYSTEM_INFO si;
+
+	GetSystemInfo(&si);
+	return (int)si.dwNumberOfProcessors;
+#else
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return (n > 0 ? (int)n : 1);
+#endif
 }
 
-int XMLDoc_parse_buffer_SAX(const SXML_CHAR* buffer, const SXML_CHAR* name, const SAX_Callbacks* sax, void* user)
+
+/* --- Parallel parsing --- */
+
+/* Minimum number of characters for a document part to be parsed by its own thread */
+#define PARALLEL_MIN_CHUNK 65536
+
+/*
+ Part of a document parsed by a thread, from 'start' up to the last tag ending at or before 'stop'.
+ Nodes and texts found outside of the nodes started in the chunk belong to nodes of previous chunks,
+ unknown until the chunks are stitched together: they are gathered as children and text of placeholder
+ nodes 'segments'. All segments but the last one end with an end tag closing a node of a previous
+ chunk, stored as the segment tag.
+ */
+typedef struct _XMLChunk {
+	const SXML_CHAR* buf;	/* Whole document */
+	size_t len;
+	size_t start;			/* Position of the first tag, speculated for all chunks but the first */
+	size_t stop;
+	size_t end;				/* Position following the last tag parsed */
+	int text_as_nodes;
+	const XMLContext* ctx;
+	XMLNode** segments;
+	int n_segments;
+	XMLNode* current;		/* Node left open at the end of the chunk, or last segment */
+	int ok;					/* 'false' for memory error or malformed document */
+} XMLChunk;
+
+/*
+ Chunks parsed by a thread: 'chunks[first]', 'chunks[first + step]', ...
+ */
+typedef struct _XMLChunkJob {
+	XMLChunk* chunks;
+	int n_chunks;
+	int first;
+	int step;
+} XMLChunkJob;
+
+static XMLNode* _chunk_add_segment(XMLChunk* ck)
+{
+	XMLNode** pt;
+	XMLNode* seg;
+
+	pt = (XMLNode**)__realloc(ck->segments, (ck->n_segments + 1) * sizeof(XMLNode*));
+	if (pt == NULL)
+		return NULL;
+	ck->segments = pt;
+	if ((seg = XMLNode_allocN(1)) == NULL)
+		return NULL;
+	ck->segments[ck->n_segments++] = seg;
+
+	return seg;
+}
+
+static void _chunk_free(XMLChunk* ck)
 {
-	DataSourceBuffer dsb = { buffer, 0 };
+	int i;
+
+	for (i = 0; i < ck->n_segments; i++) {
+		(void)XMLNode_free(ck->segments[i]);
+		__free(ck->segments[i]);
+	}
+	if (ck->segments != NULL)
+		__free(ck->segments);
+	ck->segments = NULL;
+	ck->n_segments = 0;
+	ck->current = NULL;
+}
+
+/*
+ Build the nodes of chunk 'ck' with the DOM callbacks, the current node being the last segment
+ when outside of the nodes started in the chunk.
+ */
+static void _chunk_parse(XMLChunk* ck)
+{
+	XMLParser sl;
 	SAX_Data sd;
+	DOM_through_SAX dom;
+	XMLNode* seg;
+	SXML_CHAR* text;
+	TagType tag_type;
+	int n_lines;
+
+	ck->ok = false;
+	ck->end = ck->start;
+	if ((seg = _chunk_add_segment(ck)) == NULL)
+		return;
+	dom.doc = NULL;
+	dom.current = seg;
+	dom.text_as_nodes = ck->text_as_nodes;
+	dom.error = PARSE_ERR_NONE;
+	sd.name = C2SX("");
+	sd.user = &dom;
+	sd.insitu = false;
+	sd.line_num = 1;
+	_XMLParser_init(&sl, (SXML_CHAR*)&ck->buf[ck->start], ck->len - ck->start, false, NULL, NULL, &sd, ck->ctx);
+
+	while (ck->start + sl.tok.pos < ck->stop) {
+		tag_type = _tok_next(&sl.tok, &n_lines);
+		sd.line_num += n_lines;
+		if (tag_type == TAG_PARTIAL) /* End of the document */
+			break;
+		if (tag_type < TAG_PARTIAL || (text = _XMLParser_strings(&sl, tag_type)) == NULL)
+			goto chunk_err;
+		if (sl.tok.text.len > 0 && !DOMXMLDoc_node_text(text, &sd))
+			goto chunk_err;
+		if (tag_type != TAG_END) {
+			if (!DOMXMLDoc_node_start(&sl.node, &sd))
+				goto chunk_err;
+			if (tag_type != TAG_FATHER)
+				dom.current = dom.current->father;
+		} else if (dom.current == seg) { /* End of a node started in a previous chunk */
+			if ((seg->tag = sx_strdup(sl.node.tag)) == NULL || (seg = _chunk_add_segment(ck)) == NULL)
+				goto chunk_err;
+			dom.current = seg;
+		} else if (sx_strcmp(dom.current->tag, sl.node.tag))
+			goto chunk_err;
+		else
+			dom.current = dom.current->father;
+	}
+	ck->end = ck->start + sl.tok.pos;
+	ck->current = dom.current;
+	ck->ok = true;
 
-	if (sax == NULL || buffer == NULL)
-		return false;
+chunk_err:
+	_XMLParser_release(&sl);
+}
 
+static void _chunk_jobs(void* arg)
+{
+	XMLChunkJob* job = (XMLChunkJob*)arg;
+	int i;
+
+	for (i = job->first; i < job->n_chunks; i += job->step)
+		_chunk_parse(&job->chunks[i]);
+}
+
+/*
+ Find a position to start a chunk, from 'from': right after the '>' of a tag followed by spaces and
+ a '<' starting an element or end tag. It could still be inside a comment or CDATA, which will be
+ checked when the previous chunks are parsed.
+ Return the position, or 'len' if none was found.
+ */
+static size_t _chunk_boundary(const SXML_CHAR* buf, size_t len, size_t from)
+{
+	size_t i, j;
+
+	for (i = from; (i += _find_char(&buf[i], len - i, C2SX('<'))) + 1 < len; i++) {
+		if (buf[i + 1] == C2SX('!') || buf[i + 1] == C2SX('?') || isxmlspace(buf[i + 1]))
+			continue;
+		for (j = i; j > from && isxmlspace(buf[j - 1]); j--) ;
+		if (j > from && buf[j - 1] == C2SX('>'))
+			return j;
+	}
+
+	return len;
+}
+
+static int _is_spaces(const SXML_CHAR* str)
+{
+	while (*str != NULC && sx_isspace(*str))
+		str++;
+
+	return (*str == NULC);
+}
+
+/*
+ Move the children and text of segment 'seg' to the current node of 'dom', as the DOM callbacks
+ would have done if they were found by a sequential parse.
+ Return 'false' for memory error or text outside of any node.
+ */
+static int _segment_merge(XMLNode* seg, DOM_through_SAX* dom)
+{
+	XMLNode* node = dom->current;
+	XMLNode** pt;
+	int i, n;
+
+	if (node == NULL) { /* Document nodes, where only spaces are allowed as text */
+		if (seg->text != NULL && !_is_spaces(seg->text))
+			return false;
+		for (i = 0; i < seg->n_children; i++) {
+			if (seg->children[i]->tag_type == TAG_TEXT) {
+				if (!_is_spaces(seg->children[i]->text))
+					return false;
+				continue;
+			}
+			if ((n = _add_node(&dom->doc->nodes, &dom->doc->n_nodes, &dom->doc->sz_nodes, seg->children[i])) < 0)
+				return false;
+			seg->children[i]->father = NULL;
+			seg->children[i]->i_child = -1;
+			seg->children[i] = NULL;
+			if (dom->doc->i_root < 0 && (dom->doc->nodes[n]->tag_type == TAG_FATHER || dom->doc->nodes[n]->tag_type == TAG_SELF))
+				dom->doc->i_root = n;
+		}
+		return true;
+	}
+
+	if (seg->n_children > 0) {
+		pt = (XMLNode**)_grow_array(node->children, &node->sz_children, node->n_children + seg->n_children, sizeof(XMLNode*));
+		if (pt == NULL)
+			return false;
+		node->children = pt;
+		for (i = 0; i < seg->n_children; i++) {
+			seg->children[i]->father = node;
+			seg->children[i]->i_child = node->n_children;
+			pt[node->n_children++] = seg->children[i];
+		}
+		__free(seg->children);
+		seg->children = NULL;
+		seg->n_children = 0;
+		seg->sz_children = 0;
+	}
+	if (seg->text != NULL) {
+		if (node->text == NULL) {
+			node->text = seg->text;
+			node->len_text = seg->len_text;
+			node->sz_text = seg->sz_text;
+		} else {
+			if (!_XMLNode_append_text(node, seg->text))
+				return false;
+			__free(seg->text);
+		}
+		seg->text = NULL;
+		seg->len_text = 0;
+		seg->sz_text = 0;
+	}
+
+	return true;
+}
+
+/*
+ Add the nodes of chunk 'ck' to the document of 'dom'.
+ Return 'false' for memory error or malformed document.
+ */
+static int _chunk_stitch(XMLChunk* ck, DOM_through_SAX* dom)
+{
+	XMLNode* seg = NULL;
+	int i;
+
+	for (i = 0; i < ck->n_segments; i++) {
+		seg = ck->segments[i];
+		if (!_segment_merge(seg, dom))
+			return false;
+		if (seg->tag != NULL) {
+			if (dom->current == NULL || sx_strcmp(dom->current->tag, seg->tag))
+				return false;
+			dom->current = dom->current->father;
+		}
+	}
+	if (ck->current != seg)
+		dom->current = ck->current;
+
+	return true;
+}
+
+/*
+ Parse the 'len' characters of 'buf' into 'dom' using 'n_threads' threads.
+ */
+static int _parse_parallel_DOM(const SXML_CHAR* buf, size_t len, const SXML_CHAR* name, DOM_through_SAX* dom, int n_threads, const XMLContext* ctx)
+{
+	XMLChunk* chunks = NULL;
+	XMLChunkJob* jobs = NULL;
+	SAX_Callbacks sax;
+	SAX_Data sd;
+	size_t pos;
+	int i, n, ret = false;
+
+	if (n_threads <= 0)
+		n_threads = _cpu_count();
+	if ((size_t)n_threads > len / PARALLEL_MIN_CHUNK)
+		n_threads = (int)(len / PARALLEL_MIN_CHUNK);
+	if (ctx->max_depth > 0) /* Chunks do not know the depth they start at */
+		n_threads = 1;
+	if (n_threads > 1) {
+		chunks = (XMLChunk*)__calloc(n_threads, sizeof(XMLChunk));
+		jobs = (XMLChunkJob*)__calloc(n_threads, sizeof(XMLChunkJob));
+	}
+	if (chunks == NULL || jobs == NULL)
+		goto sequential;
+
+	/* Chunks of about the same size, starting at tags */
+	for (n = 0, pos = 0; n < n_threads && pos < len; n++) {
+		chunks[n].buf = buf;
+		chunks[n].len = len;
+		chunks[n].start = pos;
+		chunks[n].text_as_nodes = dom->text_as_nodes;
+		chunks[n].ctx = ctx;
+		pos = (len / n_threads) * (n + 1);
+		if (pos <= chunks[n].start)
+			pos = chunks[n].start + 1;
+		pos = (n == n_threads - 1 ? len : _chunk_boundary(buf, len, pos));
+		chunks[n].stop = pos;
+	}
+	for (i = 0; i < n; i++) {
+		jobs[i].chunks = chunks;
+		jobs[i].n_chunks = n;
+		jobs[i].first = i;
+		jobs[i].step = n;
+	}
+	_run_threads(_chunk_jobs, jobs, sizeof(XMLChunkJob), n);
+
+	dom->current = NULL;
+	dom->error = PARSE_ERR_NONE;
+	for (i = 0, pos = 0; i < n; i++) {
+		if (chunks[i].start != pos) { /* Wrong guess, the chunk started inside a tag: parse it again from its actual start */
+			_chunk_free(&chunks[i]);
+			chunks[i].start = pos;
+			_chunk_parse(&chunks[i]);
+		}
+		if (!chunks[i].ok || !_chunk_stitch(&chunks[i], dom))
+			break;
+		pos = chunks[i].end;
+	}
+	ret = (i == n);
+	for (i = 0; i < n; i++)
+		_chunk_free(&chunks[i]);
+
+sequential:
+	if (chunks != NULL)
+		__free(chunks);
+	if (jobs != NULL)
+		__free(jobs);
+	if (ret)
+		return true;
+
+	/* Errors are reported by a sequential parse, the same way as other functions do */
+	(void)XMLDoc_free(dom->doc);
+	dom->current = NULL;
+	SAX_Callbacks_init_DOM(&sax);
 	sd.name = name;
-	sd.user = user;
-	return _parse_data_SAX((void*)&dsb, DATA_SOURCE_BUFFER, sax, &sd);
+	sd.user = dom;
+	sd.insitu = false;
+
+	return _parse_mem_SAX(buf, len, &sax, &sd, ctx);
 }
 
-int XMLDoc_parse_file_DOM_text_as_nodes(const SXML_CHAR* filename, XMLDoc* doc, int text_as_nodes)
+int XMLDoc_parse_file_DOM_parallel_text_as_nodes(const SXML_CHAR* filename, XMLDoc* doc, int text_as_nodes, int n_threads)
+{
+	return XMLDoc_parse_file_DOM_parallel_ctx(filename, doc, text_as_nodes, n_threads, NULL);
+}
+
+int XMLDoc_parse_file_DOM_parallel_ctx(const SXML_CHAR* filename, XMLDoc* doc, int text_as_nodes, int n_threads, const XMLContext* ctx)
 {
 	DOM_through_SAX dom;
-	SAX_Callbacks sax;
+	MappedFile mf;
+	const SXML_CHAR* str;
+	size_t len;
+	SXML_CHAR* wbuf;
+	int ret;
 
-	if (doc == NULL || filename == NULL || filename[0] == NULC || doc->init_value != XML_INIT_DONE)
+	if (doc == NULL || filename == NULL || filename[0] == NULC || doc->init_value != XML_INIT_DONE
+		|| (ctx != NULL && ctx->init_value != XML_INIT_DONE))
 		return false;
 
 	sx_strncpy(doc->filename, filename, SXMLC_MAX_PATH - 1);
 	doc->filename[SXMLC_MAX_PATH - 1] = NULC;
 
-	/* Read potential BOM on file, only when unicode is defined */
-#ifdef SXMLC_UNICODE
-	{
-		/* In Unicode, open the file as binary so that further 'fgetwc' read all bytes */
-		FILE* f = sx_fopen(filename, C2SX("rb"));
-		if (f != NULL) {
-			#if defined(SXMLC_UNICODE) && (defined(WIN32) || defined(WIN64))
-			//setvbuf(f, NULL, _IONBF, 0);
-			#endif
-			doc->bom_type = freadBOM(f, doc->bom, &doc->sz_bom);
-			sx_fclose(f);
-		}
-	}
-#endif
-
+	if (!_map_text(filename, &mf, doc, &str, &len, &wbuf))
+		return false;
 	dom.doc = doc;
 	dom.current = NULL;
 	dom.text_as_nodes = text_as_nodes;
-	SAX_Callbacks_init_DOM(&sax);
-
-	if (!XMLDoc_parse_file_SAX(filename, &sax, &dom)) {
+	ret = _parse_parallel_DOM(str, len, filename, &dom, n_threads, ctx != NULL ? ctx : &_default_ctx);
+	_unmap_text(&mf, wbuf);
+	if (!ret)
 		(void)XMLDoc_free(doc);
-		dom.doc = NULL;
-		return false;
-	}
 
-	return true;
+	return ret;
 }
 
-int XMLDoc_parse_buffer_DOM_text_as_nodes(const SXML_CHAR* buffer, const SXML_CHAR* name, XMLDoc* doc, int text_as_nodes)
+
+/* --- Batch parsing --- */
+
+typedef struct _XMLBatch {
+	XMLBatchItem* items;
+	int n_items;
+	int next;		/* Next item to parse */
+	XMLMutex mutex;	/* Protects 'next' */
+} XMLBatch;
+
+static void _batch_parse_item(XMLBatchItem* item)
 {
 	DOM_through_SAX dom;
 	SAX_Callbacks sax;
+	const SAX_Callbacks* psax = item->sax;
+	void* user = item->user;
+
+	item->error = PARSE_ERR_NONE;
+	item->line_error = 0;
+	if (item->sax == NULL) {
+		(void)XMLDoc_init(&item->doc);
+		dom.doc = &item->doc;
+		dom.current = NULL;
+		dom.error = PARSE_ERR_NONE;
+		dom.line_error = 0;
+		dom.text_as_nodes = item->text_as_nodes;
+		SAX_Callbacks_init_DOM(&sax);
+		psax = &sax;
+		user = &dom;
+	}
+
+	if (item->filename != NULL)
+		item->ret = (item->sax == NULL ? _parse_file_DOM(item->filename, &dom, item->ctx) : XMLDoc_parse_file_SAX_ctx(item->filename, psax, user, item->ctx));
+	else if (item->buffer == NULL)
+		item->ret = false;
+	else
+		item->ret = XMLDoc_parse_buffer_len_SAX_ctx(item->buffer, item->len > 0 ? item->len : sx_strlen(item->buffer), item->name, psax, user, item->ctx);
+
+	if (item->sax == NULL) {
+		/* Loading errors are reported through 'dom', the parsing itself can still succeed */
+		if (dom.error != PARSE_ERR_NONE)
+			item->ret = false;
+		if (!item->ret)
+			(void)XMLDoc_free(&item->doc);
+		item->error = dom.error;
+		item->line_error = dom.line_error;
+	}
+}
+
+static void _batch_worker(void* arg)
+{
+	XMLBatch* batch = (XMLBatch*)arg;
+	int i;
+
+	while (true) {
+		_mutex_lock(&batch->mutex);
+		i = batch->next++;
+		_mutex_unlock(&batch->mutex);
+		if (i >= batch->n_items)
+			break;
+		_batch_parse_item(&batch->items[i]);
+	}
+}
+
+int XMLDoc_parse_batch(XMLBatchItem* items, int n_items, int n_workers)
+{
+	XMLBatch batch;
+	int i, n;
 
-	if (doc == NULL || buffer == NULL || doc->init_value != XML_INIT_DONE)
-		return false;
+	if (items == NULL || n_items <= 0)
+		return 0;
 
-	dom.doc = doc;
-	dom.current = NULL;
-	dom.text_as_nodes = text_as_nodes;
-	SAX_Callbacks_init_DOM(&sax);
+	if (n_workers <= 0)
+		n_workers = 2 * _cpu_count();
+	if (n_workers > n_items)
+		n_workers = n_items;
+	batch.items = items;
+	batch.n_items = n_items;
+	batch.next = 0;
+	if (n_workers > 1 && _mutex_init(&batch.mutex)) {
+		_run_threads(_batch_worker, &batch, 0, n_workers);
+		_mutex_free(&batch.mutex);
+	} else
+		for (i = 0; i < n_items; i++)
+			_batch_parse_item(&items[i]);
 
-	return XMLDoc_parse_buffer_SAX(buffer, name, &sax, &dom) ? true : XMLDoc_free(doc);
-}
+	for (i = n = 0; i < n_items; i++)
+		if (items[i].ret)
+			n++;
 
+	return n;
+}
 
 
 /* --- Utility functions (ex sxmlutils.c) --- */
@@ -1773,7 +5043,7 @@ static struct _html_special_dict {
 
 int _bgetc(DataSourceBuffer* ds)
 {
-	if (ds == NULL || ds->buf[ds->cur_pos] == NULC)
+	if (_beob(ds))
 		return EOF;
 	
 	return (int)(ds->buf[ds->cur_pos++]);
@@ -1781,13 +5051,435 @@ int _bgetc(DataSourceBuffer* ds)
 
 int _beob(DataSourceBuffer* ds)
 {
+	if (ds == NULL || (ds->len > 0 ? ds->cur_pos >= ds->len : ds->buf[ds->cur_pos] == NULC))
+		return true;
+
+	return false;
+}
+
+/* Number of characters read at once from files */
+static int _read_block_size = SXMLC_READ_BLOCK_SIZE;
+
+int XML_set_read_block_size(int sz)
+{
+	int previous = _read_block_size;
+
+	if (sz > 0)
+		_read_block_size = sz;
+
+	return previous;
+}
+
+int DataSourceBlock_init(DataSourceBlock* ds, void* in, DataSourceType in_type, int sz_blk)
+{
+	XMLDataSource* src;
+	size_t sz;
+
+	if (ds == NULL || in == NULL || (in_type != DATA_SOURCE_FILE && in_type != DATA_SOURCE_BUFFER && in_type != DATA_SOURCE_CUSTOM))
+		return false;
+	if (in_type == DATA_SOURCE_CUSTOM && ((XMLDataSource*)in)->read == NULL)
+		return false;
+
+	ds->in = in;
+	ds->in_type = in_type;
+	ds->pos = 0;
+	ds->error = false;
+
+	/* Buffers are already in memory: use them directly as a single block */
+	if (in_type == DATA_SOURCE_BUFFER) {
+		DataSourceBuffer* dsb = (DataSourceBuffer*)in;
+		ds->blk = (SXML_CHAR*)&dsb->buf[dsb->cur_pos];
+		ds->sz_blk = 0;
+		ds->len = (dsb->len > 0 ? dsb->len - dsb->cur_pos : sx_strlen(ds->blk));
+		ds->eos = true;
+
+		return true;
+	}
+
+	ds->sz_blk = (sz_blk > 0 ? sz_blk : _read_block_size);
+	if (in_type == DATA_SOURCE_CUSTOM) { /* Small sources are read at once, with room to see their end */
+		src = (XMLDataSource*)in;
+		if (src->size != NULL && (sz = src->size(src->data)) > 0 && sz < (size_t)ds->sz_blk)
+			ds->sz_blk = (int)sz + 1;
+	}
+	ds->len = 0;
+	ds->eos = false;
+	ds->blk = (SXML_CHAR*)__malloc(ds->sz_blk * sizeof(SXML_CHAR));
+
+	return (ds->blk != NULL);
+}
+
+int DataSourceBlock_free(DataSourceBlock* ds)
+{
+	if (ds == NULL)
+		return false;
+
+	if (ds->in_type == DATA_SOURCE_BUFFER)
+		((DataSourceBuffer*)ds->in)->cur_pos += ds->pos;
+	else if (ds->blk != NULL)
+		__free(ds->blk);
+	ds->blk = NULL;
+	ds->sz_blk = 0;
+	ds->len = ds->pos = 0;
+
+	return true;
+}
+
+/*
+ Read the next block from the underlying data source, discarding the current one.
+ Return the number of characters available, 0 when the data source is exhausted.
+ */
+static size_t _blkfill(DataSourceBlock* ds)
+{
+	ds->pos = 0;
+	ds->len = _blkread(ds, ds->blk, ds->sz_blk);
+
+	return ds->len;
+}
+
+/*
+ Read up to 'n' characters into 'dst': the ones left in the current block first, or directly from
+ the underlying data source when the block is empty, so that they are not copied twice.
+ Return the number of characters read, 0 when the data source is exhausted.
+ */
+static size_t _blkread(DataSourceBlock* ds, SXML_CHAR* dst, size_t n)
+{
+	XMLDataSource* src;
+	FILE* f;
+	size_t k;
+#ifdef SXMLC_UNICODE
+	wint_t c;
+#endif
+
+	if (ds->pos < ds->len) {
+		k = ds->len - ds->pos;
+		if (k > n)
+			k = n;
+		memcpy(dst, &ds->blk[ds->pos], k * sizeof(SXML_CHAR));
+		ds->pos += k;
+		return k;
+	}
+	if (ds->eos)
+		return 0;
+
+	if (ds->in_type == DATA_SOURCE_CUSTOM) { /* Short reads do not tell the end, only an empty one does */
+		src = (XMLDataSource*)ds->in;
+		if ((k = src->read(src->data, dst, n)) == 0)
+			ds->eos = true;
+		return k;
+	}
+
+	f = (FILE*)ds->in;
+#ifdef SXMLC_UNICODE
+	/* Wide characters have to go through 'fgetwc' to be decoded, but at least they are read in a tight loop */
+	for (k = 0; k < n && (c = sx_fgetc(f)) != CEOF; k++)
+		dst[k] = (SXML_CHAR)c;
+#else
+	k = fread(dst, sizeof(SXML_CHAR), n, f);
+#endif
+	if (k < n) { /* Either the end of the file or a read error, which should not pass for the end */
+		ds->eos = true;
+		ds->error = (ferror(f) != 0);
+	}
+
+	return k;
+}
+
+int XMLDataSource_close(XMLDataSource* src)
+{
+	if (src == NULL)
+		return false;
+
+	if (src->close != NULL)
+		src->close(src->data);
+	src->data = NULL;
+
+	return true;
+}
+
+#ifdef SXMLC_ZLIB
+static size_t _gz_read(void* data, SXML_CHAR* buf, size_t n)
+{
+	int k;
+#ifdef SXMLC_UNICODE
+	/* Bytes are read at the end of 'buf' and widened from its start, each character being written
+	   after its byte was read */
+	unsigned char* bytes = (unsigned char*)buf + n * (sizeof(SXML_CHAR) - 1);
+	int i;
+#endif
+
+	if (n > INT_MAX)
+		n = INT_MAX;
+#ifdef SXMLC_UNICODE
+	if ((k = gzread((gzFile)data, bytes, (unsigned int)n)) <= 0)
+		return 0;
+	for (i = 0; i < k; i++)
+		buf[i] = (SXML_CHAR)bytes[i];
+#else
+	if ((k = gzread((gzFile)data, buf, (unsigned int)n)) <= 0)
+		return 0;
+#endif
+
+	return (size_t)k;
+}
+
+static void _gz_close(void* data)
+{
+	(void)gzclose((gzFile)data);
+}
+
+int XMLDataSource_init_gzip(XMLDataSource* src, const char* filename)
+{
+	gzFile gz;
+
+	if (src == NULL || filename == NULL || (gz = gzopen(filename, "rb")) == NULL)
+		return false;
+
+	src->read = _gz_read;
+	src->size = NULL;
+	src->close = _gz_close;
+	src->data = (void*)gz;
+
+	return true;
+}
+#endif
+
+int _blkgetc(DataSourceBlock* ds)
+{
+	if (ds == NULL || (ds->pos >= ds->len && _blkfill(ds) == 0))
+		return CEOF;
+
+	return (int)ds->blk[ds->pos++];
+}
 
-	if (ds == NULL || ds->buf[ds->cur_pos] == NULC)
+int _blkeob(DataSourceBlock* ds)
+{
+	if (ds == NULL || (ds->pos >= ds->len && ds->eos))
 		return true;
 
 	return false;
 }
 
+/*
+ Return the index of the first occurrence of 'c' in 'str[0..len-1]', or 'len' if not found.
+ */
+static size_t _find_char(const SXML_CHAR* str, size_t len, SXML_CHAR c)
+{
+#ifdef SXMLC_UNICODE
+	size_t i;
+
+	for (i = 0; i < len && str[i] != c; i++) ;
+
+	return i;
+#else
+	const char* p = (len > 0 ? (const char*)memchr(str, c, len) : NULL); /* 'str' can be NULL when empty */
+
+	return p == NULL ? len : (size_t)(p - str);
+#endif
+}
+
+/*
+ Return the number of occurrences of 'c' in 'str[0..len-1]'.
+ */
+static int _count_char(const SXML_CHAR* str, size_t len, SXML_CHAR c)
+{
+	int n = 0;
+	size_t i;
+
+	for (i = _find_char(str, len, c); i < len; i += 1 + _find_char(&str[i+1], len - i - 1, c))
+		n++;
+
+	return n;
+}
+
+/*
+ Structural scanner: the tokenizer looks for delimiters ('<', '>' or quotes) while counting line
+ breaks. With SSE2 or AVX2, both are compared on 16 or 32 characters at once, giving bitmasks
+ (bit 'i' set for character 'i') of delimiters and line breaks for each chunk. The first delimiter
+ is the lowest bit of the first mask, and line breaks before it are counted with a population count.
+ Without SIMD (or with 'SXMLC_NO_SIMD'), 'memchr' is used instead.
+ */
+#if defined(SXMLC_SCAN_AVX2) || defined(SXMLC_SCAN_SSE2)
+static int _ctz32(unsigned int m)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_ctz(m);
+#elif defined(_MSC_VER)
+	unsigned long i;
+	_BitScanForward(&i, m);
+	return (int)i;
+#else
+	int i;
+	for (i = 0; !(m & 1); m >>= 1, i++) ;
+	return i;
+#endif
+}
+
+static int _popcount32(unsigned int m)
+{
+#if defined(__POPCNT__) && (defined(__GNUC__) || defined(__clang__))
+	return __builtin_popcount(m);
+#else
+	/* Without the 'popcnt' instruction, compilers call a much slower library function */
+	m = m - ((m >> 1) & 0x55555555U);
+	m = (m & 0x33333333U) + ((m >> 2) & 0x33333333U);
+	m = (m + (m >> 4)) & 0x0f0f0f0fU;
+	return (int)((m * 0x01010101U) >> 24);
+#endif
+}
+#endif
+
+/*
+ Return the index of the first 'to' in 'str[0..len-1]', or 'len' if not found.
+ When 'n_interest' is not NULL, the number of 'interest' characters before 'to' is added to it.
+ */
+static size_t _scan_to(const SXML_CHAR* str, size_t len, SXML_CHAR to, SXML_CHAR interest, int* n_interest)
+{
+#if defined(SXMLC_SCAN_AVX2) || defined(SXMLC_SCAN_SSE2)
+	unsigned int m_to, m_int;
+	size_t i = 0;
+	int n = 0;
+#if defined(SXMLC_SCAN_AVX2)
+	const __m256i v_to = _mm256_set1_epi8(to), v_int = _mm256_set1_epi8(interest);
+	__m256i v;
+
+	for (; i + 32 <= len; i += 32) {
+		v = _mm256_loadu_si256((const __m256i*)(str + i));
+		m_to = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, v_to));
+		m_int = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, v_int));
+#else
+	const __m128i v_to = _mm_set1_epi8(to), v_int = _mm_set1_epi8(interest);
+	__m128i v;
+
+	for (; i + 16 <= len; i += 16) {
+		v = _mm_loadu_si128((const __m128i*)(str + i));
+		m_to = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, v_to));
+		m_int = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, v_int));
+#endif
+		if (m_to != 0) {
+			m_to = (unsigned int)_ctz32(m_to);
+			if (m_int != 0)
+				n += _popcount32(m_int & ((1U << m_to) - 1));
+			if (n_interest != NULL)
+				*n_interest += n;
+			return i + m_to;
+		}
+		if (m_int != 0)
+			n += _popcount32(m_int);
+	}
+	for (; i < len && str[i] != to; i++) /* Remaining characters */
+		if (str[i] == interest)
+			n++;
+	if (n_interest != NULL)
+		*n_interest += n;
+
+	return i;
+#else
+	size_t k = _find_char(str, len, to);
+
+	if (n_interest != NULL)
+		*n_interest += _count_char(str, k, interest);
+
+	return k;
+#endif
+}
+
+/*
+ Make sure 'line' can hold at least 'n' characters.
+ */
+static int _ensure_line_size(SXML_CHAR** line, int* sz_line, int n)
+{
+	SXML_CHAR* pt;
+	int sz;
+
+	if (n <= *sz_line)
+		return true;
+
+	sz = (n / MEM_INCR_RLA + 1) * MEM_INCR_RLA;
+	pt = (SXML_CHAR*)__realloc(*line, sz*sizeof(SXML_CHAR));
+	if (pt == NULL)
+		return false;
+	*line = pt;
+	*sz_line = sz;
+
+	return true;
+}
+
+/*
+ 'read_line_alloc' implementation for block-buffered data sources: the block is scanned in place
+ for 'from' and 'to' and whole chunks of characters are copied at once.
+ */
+static int _read_line_alloc_block(DataSourceBlock* ds, SXML_CHAR** line, int* sz_line, int i0, SXML_CHAR from, SXML_CHAR to, int keep_fromto, SXML_CHAR interest, int* interest_count)
+{
+	int n, found;
+	size_t i;
+
+	/* Search for character 'from' */
+	found = (from == NULC);
+	while (!found) {
+		if (ds->pos >= ds->len && _blkfill(ds) == 0)
+			break;
+		i = ds->pos + _scan_to(&ds->blk[ds->pos], ds->len - ds->pos, from, interest, interest_count);
+		found = (i < ds->len);
+		if (found) {
+			i++; /* Consume 'from' */
+			if (interest_count != NULL && from == interest)
+				(*interest_count)++;
+		}
+		ds->pos = i;
+	}
+
+	if (*line == NULL || *sz_line == 0) {
+		if (*sz_line == 0) *sz_line = MEM_INCR_RLA;
+		*line = (SXML_CHAR*)__malloc(*sz_line*sizeof(SXML_CHAR));
+		if (*line == NULL)
+			return 0;
+	}
+	if (i0 < 0)
+		i0 = 0;
+	if (i0 > *sz_line)
+		return 0;
+
+	n = i0;
+	(*line)[n] = NULC;
+	if (!found) /* EOF reached before 'from' char => return the empty string */
+		return (ds->error ? 0 : n); /* Error if not EOF */
+	if (from != NULC && keep_fromto) {
+		if (!_ensure_line_size(line, sz_line, n + 2))
+			return 0;
+		(*line)[n++] = from;
+	}
+
+	/* Copy characters until 'to' */
+	while (true) {
+		if (ds->pos >= ds->len && _blkfill(ds) == 0) {
+			if (ds->error)
+				return 0; /* Error if not EOF */
+			break; /* EOF before 'to' is not an error */
+		}
+		i = ds->pos + _scan_to(&ds->blk[ds->pos], ds->len - ds->pos, to, interest, interest_count);
+		found = (i < ds->len);
+		if (found) {
+			i++; /* Consume 'to' */
+			if (interest_count != NULL && to == interest)
+				(*interest_count)++;
+		}
+		if (!_ensure_line_size(line, sz_line, n + (int)(i - ds->pos) + 1))
+			return 0;
+		memcpy(&(*line)[n], &ds->blk[ds->pos], (i - ds->pos) * sizeof(SXML_CHAR));
+		n += (int)(i - ds->pos);
+		ds->pos = i;
+		if (found) {
+			if (!keep_fromto)
+				n--; /* Strip 'to' */
+			break;
+		}
+	}
+	(*line)[n] = NULC;
+
+	return n;
+}
+
 int read_line_alloc(void* in, DataSourceType in_type, SXML_CHAR** line, int* sz_line, int i0, SXML_CHAR from, SXML_CHAR to, int keep_fromto, SXML_CHAR interest, int* interest_count)
 {
 	int init_sz = 0;
@@ -1797,7 +5489,7 @@ int read_line_alloc(void* in, DataSourceType in_type, SXML_CHAR** line, int* sz_
 	int (*mgetc)(void* ds) = (in_type == DATA_SOURCE_BUFFER ? (int(*)(void*))_bgetc : (int(*)(void*))sx_fgetc);
 	int (*meos)(void* ds) = (in_type == DATA_SOURCE_BUFFER ? (int(*)(void*))_beob : (int(*)(void*))sx_feof);
 	
-	if (in == NULL || line == NULL)
+	if (in == NULL || line == NULL || in_type == DATA_SOURCE_CUSTOM)
 		return 0;
 	
 	if (to == NULC)
@@ -1805,6 +5497,10 @@ int read_line_alloc(void* in, DataSourceType in_type, SXML_CHAR** line, int* sz_
 	/* Search for character 'from' */
 	if (interest_count != NULL)
 		*interest_count = 0;
+	if (sz_line == NULL)
+		sz_line = &init_sz;
+	if (in_type == DATA_SOURCE_BLOCK)
+		return _read_line_alloc_block((DataSourceBlock*)in, line, sz_line, i0, from, to, keep_fromto, interest, interest_count);
 	while (true) {
 		/* Reaching EOF before 'to' char is not an error but should trigger 'line' alloc and init to '' */
 		c = mgetc(in);
@@ -1818,9 +5514,6 @@ int read_line_alloc(void* in, DataSourceType in_type, SXML_CHAR** line, int* sz_
 			break;
 	}
 	
-	if (sz_line == NULL)
-		sz_line = &init_sz;
-	
 	if (*line == NULL || *sz_line == 0) {
 		if (*sz_line == 0) *sz_line = MEM_INCR_RLA;
 		*line = (SXML_CHAR*)__malloc(*sz_line*sizeof(SXML_CHAR));
@@ -2129,10 +5822,130 @@ BOM_TYPE freadBOM(FILE* f, unsigned char* bom, int* sz_bom)
 
 /* --- */
 
+/*
+ Return the character of the predefined entity starting at 'str' (on its '&') and set '*n' to its
+ length, or NULC when the 'len' characters of 'str' do not start with one.
+ The entity is told by its first letter, without looking at the whole 'HTML_SPECIAL_DICT'.
+ As comparison stops on NULC, 'len' can be larger than a NUL-terminated 'str'.
+ */
+static SXML_CHAR _predefined_entity(const SXML_CHAR* str, size_t len, int* n)
+{
+	int i, k;
+
+	if (len < 4)
+		return NULC;
+	switch (str[1]) {
+		case C2SX('l'): i = 0; break;	/* "&lt;" */
+		case C2SX('g'): i = 1; break;	/* "&gt;" */
+		case C2SX('q'): i = 2; break;	/* "&quot;" */
+		case C2SX('a'): i = (str[2] == C2SX('p') ? 3 : 4); break;	/* "&apos;" or "&amp;" */
+		default: return NULC;
+	}
+	for (k = 2; k < HTML_SPECIAL_DICT[i].html_len; k++)
+		if ((size_t)k >= len || str[k] != HTML_SPECIAL_DICT[i].html[k])
+			return NULC;
+	*n = k;
+
+	return HTML_SPECIAL_DICT[i].chr;
+}
+
+/*
+ Decode the character reference starting at 'str' (on its '&'), "&#NNN;" or "&#xHH;", into 'dst'
+ (which can be 'str' as the reference is read before) and set '*n' to its length.
+ Return the number of characters written, 0 when the 'len' characters of 'str' do not start with a
+ valid reference.
+ */
+static int _char_ref(const SXML_CHAR* str, size_t len, SXML_CHAR* dst, int* n)
+{
+	unsigned long cp = 0;
+	int i = 2, hex, d;
+
+	if (len < 4 || str[1] != C2SX('#'))
+		return 0;
+	hex = (str[2] == C2SX('x'));
+	for (i += hex; (size_t)i < len && str[i] != C2SX(';') && cp <= 0x10FFFF; i++) {
+		if (str[i] >= C2SX('0') && str[i] <= C2SX('9'))
+			d = str[i] - C2SX('0');
+		else if (hex && str[i] >= C2SX('a') && str[i] <= C2SX('f'))
+			d = str[i] - C2SX('a') + 10;
+		else if (hex && str[i] >= C2SX('A') && str[i] <= C2SX('F'))
+			d = str[i] - C2SX('A') + 10;
+		else
+			return 0;
+		cp = cp * (hex ? 16 : 10) + d;
+	}
+	if ((size_t)i >= len || i == 2 + hex || cp == 0 || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+		return 0;
+	*n = i + 1;
+
+#ifdef SXMLC_UNICODE
+	if (sizeof(SXML_CHAR) == 2 && cp > 0xFFFF) { /* UTF-16 surrogate pair */
+		cp -= 0x10000;
+		dst[0] = (SXML_CHAR)(0xD800 + (cp >> 10));
+		dst[1] = (SXML_CHAR)(0xDC00 + (cp & 0x3FF));
+		return 2;
+	}
+	dst[0] = (SXML_CHAR)cp;
+	return 1;
+#else
+	if (cp < 0x80) {
+		dst[0] = (SXML_CHAR)cp;
+		return 1;
+	}
+	if (cp < 0x800) {
+		dst[0] = (SXML_CHAR)(0xC0 | (cp >> 6));
+		dst[1] = (SXML_CHAR)(0x80 | (cp & 0x3F));
+		return 2;
+	}
+	if (cp < 0x10000) {
+		dst[0] = (SXML_CHAR)(0xE0 | (cp >> 12));
+		dst[1] = (SXML_CHAR)(0x80 | ((cp >> 6) & 0x3F));
+		dst[2] = (SXML_CHAR)(0x80 | (cp & 0x3F));
+		return 3;
+	}
+	dst[0] = (SXML_CHAR)(0xF0 | (cp >> 18));
+	dst[1] = (SXML_CHAR)(0x80 | ((cp >> 12) & 0x3F));
+	dst[2] = (SXML_CHAR)(0x80 | ((cp >> 6) & 0x3F));
+	dst[3] = (SXML_CHAR)(0x80 | (cp & 0x3F));
+	return 4;
+#endif
+}
+
+/*
+ Decode the predefined entities and character references of the 'len' characters of 'str', in place.
+ Runs of characters without '&' are found with '_find_char' and moved at once.
+ Return the decoded length. Unknown or invalid references are left as they are.
+ */
+static size_t _decode_entities(SXML_CHAR* str, size_t len)
+{
+	size_t i = _find_char(str, len, C2SX('&')), j = i, k;
+	SXML_CHAR c;
+	int n;
+
+	while (i < len) { /* On a '&' */
+		if ((c = _predefined_entity(&str[i], len - i, &n)) != NULC) {
+			str[j++] = c;
+			i += n;
+		} else if ((k = (size_t)_char_ref(&str[i], len - i, &str[j], &n)) > 0) {
+			j += k;
+			i += n;
+		} else
+			str[j++] = str[i++];
+		/* Move the characters up to the next '&' */
+		k = _find_char(&str[i], len - i, C2SX('&'));
+		if (j != i)
+			memmove(&str[j], &str[i], k * sizeof(SXML_CHAR));
+		i += k;
+		j += k;
+	}
+
+	return j;
+}
+
 SXML_CHAR* html2str(SXML_CHAR* html, SXML_CHAR* str)
 {
-	SXML_CHAR *ps, *pd;
-	int i;
+	SXML_CHAR *ps, *pd, c;
+	int n;
 
 	if (html == NULL) return NULL;
 
@@ -2148,16 +5961,10 @@ SXML_CHAR* html2str(SXML_CHAR* html, SXML_CHAR* str)
 			continue;
 		}
 		
-		for (i = 0; HTML_SPECIAL_DICT[i].chr; i++) {
-			if (sx_strncmp(ps, HTML_SPECIAL_DICT[i].html, HTML_SPECIAL_DICT[i].html_len))
-				continue;
-			
-			*pd = HTML_SPECIAL_DICT[i].chr;
-			ps += HTML_SPECIAL_DICT[i].html_len-1;
-			break;
-		}
-		/* If no string was found, simply copy the character */
-		if (HTML_SPECIAL_DICT[i].chr == NULC && pd != ps)
+		if ((c = _predefined_entity(ps, (size_t)-1, &n)) != NULC) {
+			*pd = c;
+			ps += n - 1;
+		} else if (pd != ps) /* If no string was found, simply copy the character */
 			*pd = *ps;
 	}
 	*pd = NULC;
@@ -106,6 +106,10 @@ extern "C" {
 #define MEM_INCR_RLA (256*sizeof(SXML_CHAR)) /* Initial buffer size and increment for memory reallocations */
 #endif
 
+#ifndef SXMLC_READ_BLOCK_SIZE
+#define SXMLC_READ_BLOCK_SIZE (64*1024) /* Default number of characters read at once from a file by the parser */
+#endif
+
 #ifndef false
 #define false 0
 #endif
@@ -116,24 +120,65 @@ extern "C" {
 
 #define NULC ((SXML_CHAR)C2SX('\0'))
 #define isquote(c) (((c) == C2SX('"')) || ((c) == C2SX('\'')))
+#define isxmlspace(c) (((c) == C2SX(' ')) || ((c) == C2SX('\t')) || ((c) == C2SX('\n')) || ((c) == C2SX('\r'))) /* XML white space, regardless of locale */
 
 /*
  Buffer data source used by 'read_line_alloc' when required.
- 'buf' should be 0-terminated.
+ 'buf' should be 0-terminated, unless its number of characters is given in 'len'.
  */
 typedef struct _DataSourceBuffer {
 	const SXML_CHAR* buf;
-	int cur_pos;
+	size_t cur_pos;
+	size_t len;		/* Number of characters in 'buf', or 0 when 'buf' ends at its first NUL */
 } DataSourceBuffer;
 
 typedef FILE* DataSourceFile;
 
+/*
+ Custom data source, for characters coming from e.g. a pipe, a ring buffer or a decompressor.
+ Characters are pulled by bulk reads into the parser buffer. Only 'read' is required.
+ */
+typedef struct _XMLDataSource {
+	/*
+	 Read up to 'n' characters into 'buf'. Return the number of characters read, which can be less
+	 than 'n' before the end (e.g. for pipes), or 0 at the end of data or on error.
+	 */
+	size_t (*read)(void* data, SXML_CHAR* buf, size_t n);
+
+	/* Optional hint: total number of characters to be read, 0 if unknown. Used to size the read block */
+	size_t (*size)(void* data);
+
+	/* Optional: release 'data', called by 'XMLDataSource_close' */
+	void (*close)(void* data);
+
+	void* data;		/* Source state given to the functions above */
+} XMLDataSource;
+
 typedef enum _DataSourceType {
 	DATA_SOURCE_FILE = 0,
 	DATA_SOURCE_BUFFER,
+	DATA_SOURCE_BLOCK,
+	DATA_SOURCE_CUSTOM,		/* 'XMLDataSource*', only read through a 'DataSourceBlock' */
 	DATA_SOURCE_MAX
 } DataSourceType;
 
+/*
+ Block-buffered data source wrapping a file or buffer data source.
+ Characters are read from 'in' by blocks of 'sz_blk' characters, which are then scanned
+ in place by 'read_line_alloc' instead of being read one at a time.
+ When 'in' is a buffer, the buffer itself is used as the block and no copy is performed.
+ */
+typedef struct _DataSourceBlock {
+	void* in;				/* Underlying data source ('FILE*', 'DataSourceBuffer*' or 'XMLDataSource*') */
+	DataSourceType in_type;	/* Type of 'in' ('DATA_SOURCE_FILE', 'DATA_SOURCE_BUFFER' or 'DATA_SOURCE_CUSTOM') */
+	SXML_CHAR* blk;			/* Block of characters read from 'in' */
+	int sz_blk;				/* Allocated size of 'blk', 0 when 'blk' points inside a buffer data source */
+	size_t len;				/* Number of characters available in 'blk' */
+	size_t pos;				/* Index of the next character to read in 'blk' */
+	int eos;				/* 'true' when 'in' has been read entirely, or could not be read */
+	int error;				/* 'true' when reading 'in' failed */
+} DataSourceBlock;
+
 #ifndef false
 #define false 0
 #endif
@@ -170,28 +215,53 @@ typedef struct _XMLAttribute {
 /* Constant to know whether a struct has been initialized (XMLNode or XMLDoc) */
 #define XML_INIT_DONE 0x19770522 /* Happy Birthday ;) */
 
+/*
+ Flags for the 'borrowed' member of XMLNode, telling which strings are not owned by the node
+ (e.g. when they point inside a buffer parsed in-situ) and should not be freed with it.
+ */
+#define XML_BORROWED_TAG 0x01
+#define XML_BORROWED_TEXT 0x02
+#define XML_BORROWED_ATTRIBUTES 0x04	/* Attribute names and values. The 'attributes' array itself is always owned */
+#define XML_BORROWED_NODE 0x08	/* The node struct itself belongs to a document arena (see 'XMLDoc_init_arena') */
+#define XML_PACKED_ATTRIBUTES 0x10	/* Attribute names and values are borrowed from the 'tag' allocation, which the node owns */
+
 /*
  An XML node.
  */
 typedef struct _XMLNode {
 	SXML_CHAR* tag;				/* Tag name */
 	SXML_CHAR* text;			/* Text inside the node */
+	size_t len_text;			/* Length of 'text' (in characters), kept by the functions setting it */
+	size_t sz_text;				/* Allocated size of 'text' (in characters) when owned by the node, 0 if unknown */
 	XMLAttribute* attributes;
 	int n_attributes;
+	int sz_attributes;			/* Allocated size of 'attributes' */
 	
 	struct _XMLNode* father;	/* NULL if root */
+	int i_child;				/* Index of the node in 'father->children', -1 if root */
 	struct _XMLNode** children;
 	int n_children;
+	int sz_children;			/* Allocated size of 'children' */
 	
 	TagType tag_type;	/* Node type ('TAG_FATHER', 'TAG_SELF' or 'TAG_END') */
 	int active;		/* 'true' to tell that node is active and should be displayed by 'XMLDoc_print' */
 
 	void* user;	/* Pointer for user data associated to the node */
 
+	int borrowed;	/* Combination of 'XML_BORROWED_*' flags for strings not owned by the node */
+
 	/* Keep 'init_value' as the last member */
 	int init_value;	/* Initialized to 'XML_INIT_DONE' to indicate that node has been initialized properly */
 } XMLNode;
 
+/*
+ Memory arena of a document: nodes and strings are allocated from large chunks, all released at once.
+ */
+typedef struct _XMLArena {
+	struct _XMLArenaChunk* chunks;	/* Current chunk first */
+	size_t sz_chunk;				/* Size of the chunks, 0 when the arena is not used */
+} XMLArena;
+
 /*
  An XML document.
  */
@@ -207,7 +277,9 @@ typedef struct _XMLDoc {
 #endif
 	XMLNode** nodes;		/* Nodes of the document, including prolog, comments and root nodes */
 	int n_nodes;			/* Number of nodes in 'nodes' */
+	int sz_nodes;			/* Allocated size of 'nodes' */
 	int i_root;				/* Index of first root node in 'nodes', -1 if document is empty */
+	XMLArena arena;			/* Arena for the nodes loaded, see 'XMLDoc_init_arena' */
 
 	/* Keep 'init_value' as the last member */
 	int init_value;	/* Initialized to 'XML_INIT_DONE' to indicate that document has been initialized properly */
@@ -220,6 +292,8 @@ typedef struct _XMLDoc {
  to check for an already-existing tag_type.
  Return tag index in user tags table when successful, or '-1' if the 'tag_type' is invalid or
  the new tag could not be registered (e.g. when 'start' does not start with '<' or 'end' does not end with '>').
+ User tags are shared by all parsers, which only read them: they should not be registered or
+ unregistered while documents are being parsed by other threads.
  */
 int XML_register_user_tag(TagType tag_type, SXML_CHAR* start, SXML_CHAR* end);
 
@@ -239,6 +313,94 @@ int XML_get_nb_registered_user_tags(void);
  */
 int XML_get_registered_user_tag(TagType tag_type);
 
+/* --- Parser context --- */
+
+/*
+ Tag registered by the user, with its 'start' and 'end' strings (see 'XML_register_user_tag').
+ */
+typedef struct _XMLUserTag {
+	TagType tag_type;
+	SXML_CHAR* start;
+	int len_start;
+	SXML_CHAR* end;
+	int len_end;
+} XMLUserTag;
+
+typedef int (*REGEXPR_COMPARE)(SXML_CHAR* str, SXML_CHAR* pattern);
+
+/*
+ Configuration of parsers and searches, given to the '_ctx' functions.
+ Functions without a '_ctx' suffix use a default context holding the tags registered with
+ 'XML_register_user_tag'. Giving each thread its own context allows parsing and searching with
+ different configurations concurrently, as contexts are only read by the functions using them.
+ Members can be set directly after 'XMLContext_init', but user tags should be handled by
+ 'XMLContext_register_user_tag' and 'XMLContext_unregister_user_tag'.
+ */
+typedef struct _XMLContext {
+	XMLUserTag* user_tags;		/* Registered user tags */
+	int n_user_tags;
+
+	/* Function used by searches to match a string against a pattern, NULL for 'regstrcmp' */
+	REGEXPR_COMPARE regexpr_compare;
+
+	/*
+	 Allocator of the memory used by parsers for the characters being parsed, NULL for the default one.
+	 'mem_realloc' is called with a NULL 'mem' to allocate.
+	 Nodes given to callbacks or added to documents are not allocated with it.
+	 */
+	void* (*mem_realloc)(void* mem, size_t sz);
+	void (*mem_free)(void* mem);
+
+	/* Parsing limits, 0 for no limit. Exceeding one stops parsing with a 'PARSE_ERR_LIMIT' error */
+	size_t max_token;		/* Maximum number of characters of a text and the tag following it */
+	int max_attributes;		/* Maximum number of attributes in a tag */
+	int max_depth;			/* Maximum number of nested nodes */
+
+	/*
+	 'true' to track only offsets while parsing instead of counting lines: 'SAX_Data.line_num' is then
+	 only set when an error is reported, and line and column are given by 'SAX_Data_get_position'.
+	 */
+	int lazy_lines;
+
+	/*
+	 'true' to decode predefined entities (e.g. '&amp;') and character references (e.g. '&#233;' or
+	 '&#xE9;') in place in the texts and attribute values given to SAX callbacks, or added to documents.
+	 Character references are encoded in UTF-8, or as wide characters with 'SXMLC_UNICODE'.
+	 Otherwise, attribute values only have their predefined entities decoded (see 'html2str') and
+	 texts are left untouched.
+	 */
+	int decode_entities;
+
+	/*
+	 Set of the characters following '<' in user tags, indexed by their low byte. It is maintained
+	 by 'XMLContext_register_user_tag' and 'XMLContext_unregister_user_tag' so that other tags
+	 are told apart from user tags without looking at each of them.
+	 */
+	unsigned char user_tag_chars[32];
+
+	/* Keep 'init_value' as the last member */
+	int init_value;	/* Initialized to 'XML_INIT_DONE' to indicate that context has been initialized properly */
+} XMLContext;
+
+/*
+ Initialize 'ctx' with no user tags, default comparison function and allocator and no limits.
+ Return 'false' when 'ctx' is NULL.
+ */
+int XMLContext_init(XMLContext* ctx);
+
+/*
+ Release the memory held by 'ctx' (its user tags table), which is then initialized again.
+ Return 'false' when 'ctx' is NULL or not initialized.
+ */
+int XMLContext_free(XMLContext* ctx);
+
+/*
+ Same as 'XML_register_user_tag' and 'XML_unregister_user_tag' on the user tags of 'ctx'.
+ */
+int XMLContext_register_user_tag(XMLContext* ctx, TagType tag_type, SXML_CHAR* start, SXML_CHAR* end);
+
+int XMLContext_unregister_user_tag(XMLContext* ctx, int i_tag);
+
 
 typedef enum _ParseError {
 	PARSE_ERR_NONE = 0,
@@ -247,7 +409,9 @@ typedef enum _ParseError {
 	PARSE_ERR_SYNTAX = -3,
 	PARSE_ERR_EOF = -4,
 	PARSE_ERR_TEXT_OUTSIDE_NODE = -5, /* During DOM loading */
-	PARSE_ERR_UNEXPECTED_NODE_END = -6 /* During DOM loading */
+	PARSE_ERR_UNEXPECTED_NODE_END = -6, /* During DOM loading */
+	PARSE_ERR_LIMIT = -7, /* A limit of the parser context was exceeded */
+	PARSE_ERR_READ = -8 /* The document could not be read entirely (e.g. I/O error) */
 } ParseError;
 
 /*
@@ -271,6 +435,10 @@ typedef struct _SAX_Data {
 	const SXML_CHAR* name;
 	int line_num;
 	void* user;
+	int insitu;	/* 'true' when nodes and text given to callbacks point inside the parsed buffer and remain valid afterwards */
+	size_t offset;	/* Offset (in characters) in the document of the text or tag of the current event */
+	int skip_subtree;	/* Set to 'true' when a node starts to skip its content (see 'start_node' in 'SAX_Callbacks') */
+	struct _XMLTokenizer* tok;	/* Tokenizer of the parser, for internal use */
 } SAX_Data;
 
 /*
@@ -292,6 +460,11 @@ typedef struct _SAX_Callbacks {
 	 If any, attributes can be read from 'node->attributes'.
 	 N.B. '<tag/>' will trigger an immediate call to the 'end_node' callback
 	 after the 'start_node' callback.
+	 Setting 'sd->skip_subtree' to 'true' skips the content of the node: its descendants are only
+	 scanned to find the matching end tag, without callbacks, and 'end_node' is then called.
+	 'node' is a scratch node whose tag, attributes and their storage are reused from one
+	 event to the other, so that parsing does not allocate memory for each node. They are only
+	 valid during the callback and should be copied (e.g. with 'XMLNode_dup') to be kept.
 	 */
 	int (*start_node)(const XMLNode* node, SAX_Data* sd);
 
@@ -302,6 +475,7 @@ typedef struct _SAX_Callbacks {
 
 	/*
 	 Callback called when text has been found in the last node.
+	 As for nodes, 'text' is only valid during the callback.
 	 */
 	int (*new_text)(SXML_CHAR* text, SAX_Data* sd);
 
@@ -354,6 +528,70 @@ typedef struct _SAX_Callbacks {
  */
 int SAX_Callbacks_init(SAX_Callbacks* sax);
 
+/*
+ Compute in '*line' and '*column' (both starting at 1) the position of the current event ('sd->offset'),
+ when parsing with a context having 'lazy_lines' set. Line breaks are only counted when this is called
+ (or an error is reported), up to the event. It can only be called from callbacks.
+ Return 'false' when 'sd' is not parsed in lazy lines mode. '*column' is 0 when it cannot be known.
+ */
+int SAX_Data_get_position(SAX_Data* sd, int* line, int* column);
+
+/*
+ View on 'len' characters starting at 'ptr'. The characters are NOT NUL-terminated.
+ */
+typedef struct _XMLView {
+	const SXML_CHAR* ptr;
+	size_t len;
+} XMLView;
+
+/*
+ Attribute given to view callbacks. 'value' is the raw value, without its quotes and
+ with its HTML escape sequences left untouched (see 'html2str').
+ */
+typedef struct _XMLAttributeView {
+	XMLView name;
+	XMLView value;
+} XMLAttributeView;
+
+/*
+ Zero-copy flavour of 'SAX_Callbacks': tag, attributes and text are given as views on the
+ characters being parsed, so no allocation is made per event.
+ Views are only valid during the callback (or as long as the buffer given to
+ 'XMLDoc_parse_buffer_SAX_view'). Return values of these callbacks should be 0 to stop parsing.
+ Members can be set to NULL to disable handling of some events.
+ */
+typedef struct _SAX_View_Callbacks {
+	int (*start_doc)(SAX_Data* sd);
+
+	/*
+	 Callback called when a new node starts: 'tag' is its tag name (or the content of special
+	 tags like comments), 'tag_type' its type and 'attributes' its 'n_attributes' attributes.
+	 'attributes' array is reused for the next node.
+	 N.B. nodes other than 'TAG_FATHER' trigger an immediate call to the 'end_node' callback.
+	 */
+	int (*start_node)(const XMLView* tag, TagType tag_type, const XMLAttributeView* attributes, int n_attributes, SAX_Data* sd);
+
+	/*
+	 Callback called when a node ends (e.g. '</tag>' or '<tag/>'). 'tag_type' is 'TAG_END' for '</tag>'.
+	 */
+	int (*end_node)(const XMLView* tag, TagType tag_type, SAX_Data* sd);
+
+	/*
+	 Callback called when raw text (no HTML escape sequences conversion) has been found in the last node.
+	 */
+	int (*new_text)(const XMLView* text, SAX_Data* sd);
+
+	int (*on_error)(ParseError error_num, int line_number, SAX_Data* sd);
+
+	int (*end_doc)(SAX_Data* sd);
+} SAX_View_Callbacks;
+
+/*
+ Helper function to initialize all 'sax' members to NULL.
+ Return 'false' is 'sax' is NULL.
+ */
+int SAX_View_Callbacks_init(SAX_View_Callbacks* sax);
+
 /*
  Set of SAX callbacks used by 'XMLDoc_parse_file_DOM'.
  These are made available to be able to load an XML document using DOM implementation
@@ -426,6 +664,13 @@ int XMLNode_init(XMLNode* node);
  */
 int XMLNode_free(XMLNode* node);
 
+/*
+ Free a node allocated by 'XMLNode_alloc' or loaded in a document, and the node itself, unless
+ it belongs to a document arena (see 'XMLDoc_init_arena'), in which case it is released with it.
+ Return 'false' if 'node' was not initialized.
+ */
+int XMLNode_delete(XMLNode* node);
+
 /*
  Free XMLNode 'dst' and copy 'src' to 'dst', along with its children if specified.
  If 'src' is NULL, 'dst' is freed and initialized.
@@ -501,6 +746,13 @@ int XMLNode_remove_attribute(XMLNode* node, int i_attr);
  */
 int XMLNode_remove_all_attributes(XMLNode* node);
 
+/*
+ Make room for 'n' attributes in 'node', so that adding them does not reallocate its attribute array.
+ Attribute and children arrays otherwise grow geometrically.
+ Return 'false' for memory error or invalid arguments.
+ */
+int XMLNode_reserve_attributes(XMLNode* node, int n);
+
 /*
  Set node text.
  Return 'true' when successful, 'false' on error.
@@ -542,6 +794,12 @@ int XMLNode_remove_child(XMLNode* node, int i_child, int free_child);
  */
 int XMLNode_remove_children(XMLNode* node);
 
+/*
+ Make room for 'n' children in 'node', so that adding them does not reallocate its children array.
+ Return 'false' for memory error or invalid arguments.
+ */
+int XMLNode_reserve_children(XMLNode* node, int n);
+
 /*
  Return 'true' if 'node1' is the same as 'node2' (i.e. same tag, same active attributes).
  */
@@ -553,6 +811,12 @@ int XMLNode_equal(const XMLNode* node1, const XMLNode* node2);
  */
 XMLNode* XMLNode_next_sibling(const XMLNode* node);
 
+/*
+ Return the previous sibling of node 'node', or NULL if 'node' is invalid or the first child
+ or if its father could not be determined (i.e. 'node' is a root node).
+ */
+XMLNode* XMLNode_prev_sibling(const XMLNode* node);
+
 /*
  Return the next node in XML order i.e. first child or next sibling, or NULL
  if 'node' is invalid or the end of its root node is reached.
@@ -568,6 +832,20 @@ XMLNode* XMLNode_next(const XMLNode* node);
  */
 int XMLDoc_init(XMLDoc* doc);
 
+#ifndef XML_ARENA_CHUNK
+#define XML_ARENA_CHUNK 65536
+#endif
+/*
+ Initialize an already-allocated XML document, which nodes will be loaded in an arena: nodes,
+ tags, texts and attribute names and values are allocated from chunks of 'sz_chunk' bytes
+ ('XML_ARENA_CHUNK' when 0) owned by 'doc', and released at once by 'XMLDoc_free'.
+ Loaded nodes can still be modified: strings they are given are allocated on the heap, but they
+ should be removed with 'XMLNode_delete' (or 'XMLNode_remove_child' and such) and not 'free',
+ and cannot outlive 'doc', even when moved to another document.
+ Attribute and children arrays are allocated on the heap. The parallel loader does not use the arena.
+ */
+int XMLDoc_init_arena(XMLDoc* doc, size_t sz_chunk);
+
 /*
  Free an XML document.
  Return 'false' if 'doc' was not initialized.
@@ -596,6 +874,14 @@ int XMLDoc_add_node(XMLDoc* doc, XMLNode* node);
  */
 int XMLDoc_remove_node(XMLDoc* doc, int i_node, int free_node);
 
+/*
+ Release the memory reserved for growth by the nodes of 'doc' (children and attribute arrays,
+ and texts), e.g. once it is loaded and will not be modified.
+ Return 'false' if 'doc' was not initialized. Memory errors are not reported, as arrays that
+ cannot be reallocated are simply kept.
+ */
+int XMLDoc_shrink_to_fit(XMLDoc* doc);
+
 /*
  Shortcut macro to retrieve root node from a document.
  Equivalent to
@@ -639,6 +925,12 @@ int XMLNode_print_attr_sep(const XMLNode* node, FILE* f, const SXML_CHAR* tag_se
 /* For backward compatibility */
 #define XMLNode_print(node, f, tag_sep, child_sep, keep_text_spaces, sz_line, nb_char_tab) XMLNode_print_attr_sep(node, f, tag_sep, child_sep, C2SX(" "), keep_text_spaces, sz_line, nb_char_tab)
 
+/*
+ Same as 'XMLNode_print_attr_sep' printing user tags as registered in context 'ctx' (see 'XMLContext'),
+ or in the default context if NULL. Nodes loaded with a context should be printed with the same one.
+ */
+int XMLNode_print_ctx(const XMLNode* node, FILE* f, const SXML_CHAR* tag_sep, const SXML_CHAR* child_sep, const SXML_CHAR* attr_sep, int keep_text_spaces, int sz_line, int nb_char_tab, const XMLContext* ctx);
+
 /*
  Print the node "header": <tagname attribname="attibval" ...[/]>, spanning it on several lines if needed.
  Return 'false' on invalid arguments (NULL 'node' or 'f'), 'true' otherwise.
@@ -653,6 +945,12 @@ int XMLDoc_print_attr_sep(const XMLDoc* doc, FILE* f, const SXML_CHAR* tag_sep,
 /* For backward compatibility */
 #define XMLDoc_print(doc, f, tag_sep, child_sep, keep_text_spaces, sz_line, nb_char_tab) XMLDoc_print_attr_sep(doc, f, tag_sep, child_sep, C2SX(" "), keep_text_spaces, sz_line, nb_char_tab)
 
+/*
+ Same as 'XMLDoc_print_attr_sep' printing user tags as registered in context 'ctx' (see 'XMLContext'),
+ or in the default context if NULL.
+ */
+int XMLDoc_print_ctx(const XMLDoc* doc, FILE* f, const SXML_CHAR* tag_sep, const SXML_CHAR* child_sep, const SXML_CHAR* attr_sep, int keep_text_spaces, int sz_line, int nb_char_tab, const XMLContext* ctx);
+
 /*
  Create a new XML document from a given 'filename' and load it to 'doc'.
  'text_as_nodes' should be non-zero to put text into separate TAG_TEXT nodes.
@@ -663,6 +961,12 @@ int XMLDoc_parse_file_DOM_text_as_nodes(const SXML_CHAR* filename, XMLDoc* doc,
 /* For backward compatibility */
 #define XMLDoc_parse_file_DOM(filename, doc) XMLDoc_parse_file_DOM_text_as_nodes(filename, doc, 0)
 
+/*
+ Same as 'XMLDoc_parse_file_DOM_text_as_nodes' using the context 'ctx' (see 'XMLContext'), or the
+ default context if NULL.
+ */
+int XMLDoc_parse_file_DOM_ctx(const SXML_CHAR* filename, XMLDoc* doc, int text_as_nodes, const XMLContext* ctx);
+
 /*
  Create a new XML document from a memory buffer 'buffer' that can be given a name 'name', and load
  it into 'doc'.
@@ -674,6 +978,99 @@ int XMLDoc_parse_buffer_DOM_text_as_nodes(const SXML_CHAR* buffer, const SXML_CH
 /* For backward compatibility */
 #define XMLDoc_parse_buffer_DOM(buffer, name, doc) XMLDoc_parse_buffer_DOM_text_as_nodes(buffer, name, doc, 0)
 
+/*
+ Same as 'XMLDoc_parse_buffer_DOM_text_as_nodes' but only the first 'len' characters of 'buffer' are
+ parsed. 'buffer' does not need to be NUL-terminated (and can contain NUL characters): nothing is read
+ past 'len', so a slice of a larger buffer can be parsed without being copied.
+ Return 'false' in case of error (memory or malformed document), 'true' otherwise.
+ */
+int XMLDoc_parse_buffer_len_DOM_text_as_nodes(const SXML_CHAR* buffer, size_t len, const SXML_CHAR* name, XMLDoc* doc, int text_as_nodes);
+
+#define XMLDoc_parse_buffer_len_DOM(buffer, len, name, doc) XMLDoc_parse_buffer_len_DOM_text_as_nodes(buffer, len, name, doc, 0)
+
+/*
+ Same as 'XMLDoc_parse_buffer_len_DOM_text_as_nodes' using the context 'ctx', or the default context if NULL.
+ */
+int XMLDoc_parse_buffer_len_DOM_ctx(const SXML_CHAR* buffer, size_t len, const SXML_CHAR* name, XMLDoc* doc, int text_as_nodes, const XMLContext* ctx);
+
+/*
+ Same as 'XMLDoc_parse_buffer_DOM_text_as_nodes' but 'buffer' is parsed in-situ (see
+ 'XMLDoc_parse_buffer_insitu_SAX'): node tags, attributes and texts point inside 'buffer' instead
+ of being copied. 'buffer' is therefore modified and should be kept as long as 'doc' is used.
+ 'XMLDoc_free' only releases the nodes, not the strings inside 'buffer'.
+ Return 'false' in case of error (memory or malformed document), 'true' otherwise.
+ */
+int XMLDoc_parse_buffer_insitu_DOM_text_as_nodes(SXML_CHAR* buffer, const SXML_CHAR* name, XMLDoc* doc, int text_as_nodes);
+
+#define XMLDoc_parse_buffer_insitu_DOM(buffer, name, doc) XMLDoc_parse_buffer_insitu_DOM_text_as_nodes(buffer, name, doc, 0)
+
+/*
+ Same as 'XMLDoc_parse_file_DOM_text_as_nodes' but the file is mapped in memory (hinted for sequential
+ access) and parsed directly from the mapping, without intermediate copies.
+ The file is read as binary: no end-of-line translation is performed.
+ When 'SXMLC_NO_MMAP' is defined, the whole file is read into memory instead.
+ Return 'false' in case of error (memory or unavailable filename, malformed document), 'true' otherwise.
+ */
+int XMLDoc_parse_mmap_DOM_text_as_nodes(const SXML_CHAR* filename, XMLDoc* doc, int text_as_nodes);
+
+#define XMLDoc_parse_mmap_DOM(filename, doc) XMLDoc_parse_mmap_DOM_text_as_nodes(filename, doc, 0)
+
+/*
+ Same as 'XMLDoc_parse_mmap_DOM_text_as_nodes' but the document is split into chunks that are parsed
+ concurrently by 'n_threads' threads (the number of processors if 'n_threads' is 0 or less), then
+ stitched together in document order. Documents too small to be split are parsed sequentially.
+ Chunks start after a tag followed by a '<' that looks like the start of an element. That guess is
+ checked against the end of the previous chunk, and a chunk that actually started inside a comment,
+ CDATA or attribute value is parsed again from its right position.
+ The resulting document is the same as with 'XMLDoc_parse_file_DOM_text_as_nodes'. Malformed documents
+ are parsed again sequentially so that errors are reported the same way.
+ When 'SXMLC_NO_THREADS' is defined, chunks are parsed one after the other by the calling thread.
+ Return 'false' in case of error (memory or unavailable filename, malformed document), 'true' otherwise.
+ */
+int XMLDoc_parse_file_DOM_parallel_text_as_nodes(const SXML_CHAR* filename, XMLDoc* doc, int text_as_nodes, int n_threads);
+
+#define XMLDoc_parse_file_DOM_parallel(filename, doc, n_threads) XMLDoc_parse_file_DOM_parallel_text_as_nodes(filename, doc, 0, n_threads)
+
+/*
+ Same as 'XMLDoc_parse_file_DOM_parallel_text_as_nodes' using the context 'ctx' (see 'XMLContext'),
+ or the default context if NULL.
+ As chunks do not know the depth they start at, the document is parsed sequentially when 'ctx'
+ has a 'max_depth' limit.
+ */
+int XMLDoc_parse_file_DOM_parallel_ctx(const SXML_CHAR* filename, XMLDoc* doc, int text_as_nodes, int n_threads, const XMLContext* ctx);
+
+/*
+ A document to parse with 'XMLDoc_parse_batch'.
+ */
+typedef struct _XMLBatchItem {
+	const SXML_CHAR* filename;	/* File to parse, or NULL to parse 'buffer' */
+	const SXML_CHAR* buffer;	/* Buffer to parse when 'filename' is NULL */
+	size_t len;					/* Number of characters in 'buffer', 0 when it is NUL-terminated */
+	const SXML_CHAR* name;		/* Name given to 'buffer' */
+	const SAX_Callbacks* sax;	/* SAX callbacks to call with 'user', or NULL to load the document into 'doc' */
+	void* user;
+	int text_as_nodes;			/* Put text into separate TAG_TEXT nodes of 'doc' */
+	const XMLContext* ctx;		/* Context to parse with, NULL for the default context */
+
+	/* Set by 'XMLDoc_parse_batch' */
+	XMLDoc doc;					/* Document loaded when 'sax' is NULL, to be freed with 'XMLDoc_free' */
+	int ret;					/* Return value of the parse function ('true' when successful) */
+	ParseError error;			/* Error that stopped loading 'doc', 'PARSE_ERR_NONE' if the file could not be read */
+	int line_error;				/* Line where 'error' was found */
+} XMLBatchItem;
+
+/*
+ Parse the 'n_items' documents described by 'items' concurrently with 'n_workers' threads (twice the
+ number of processors if 'n_workers' is 0 or less, so that reading files overlaps parsing).
+ Each item is parsed as with 'XMLDoc_parse_file_DOM_text_as_nodes' or 'XMLDoc_parse_file_SAX' (or
+ their buffer equivalents), and gets its own result. SAX callbacks can therefore be called from
+ several threads at once, though never concurrently for the same item.
+ Items without a context share the default one, which user tags should not be changed while the batch runs.
+ When 'SXMLC_NO_THREADS' is defined, items are parsed one after the other by the calling thread.
+ Return the number of documents successfully parsed.
+ */
+int XMLDoc_parse_batch(XMLBatchItem* items, int n_items, int n_workers);
+
 /*
  Parse an XML document from a given 'filename', calling SAX callbacks given in the 'sax' structure.
  'user' is a user-given pointer that will be given back to all callbacks.
@@ -681,6 +1078,11 @@ int XMLDoc_parse_buffer_DOM_text_as_nodes(const SXML_CHAR* buffer, const SXML_CH
  */
 int XMLDoc_parse_file_SAX(const SXML_CHAR* filename, const SAX_Callbacks* sax, void* user);
 
+/*
+ Same as 'XMLDoc_parse_file_SAX' using the context 'ctx' (see 'XMLContext'), or the default context if NULL.
+ */
+int XMLDoc_parse_file_SAX_ctx(const SXML_CHAR* filename, const SAX_Callbacks* sax, void* user, const XMLContext* ctx);
+
 /*
  Parse an XML document from a memory buffer 'buffer' that can be given a name 'name',
  calling SAX callbacks given in the 'sax' structure.
@@ -689,6 +1091,104 @@ int XMLDoc_parse_file_SAX(const SXML_CHAR* filename, const SAX_Callbacks* sax, v
  */
 int XMLDoc_parse_buffer_SAX(const SXML_CHAR* buffer, const SXML_CHAR* name, const SAX_Callbacks* sax, void* user);
 
+/*
+ Same as 'XMLDoc_parse_buffer_SAX' but only the first 'len' characters of 'buffer' are parsed, without
+ depending on a NUL terminator (see 'XMLDoc_parse_buffer_len_DOM_text_as_nodes').
+ Return 'false' in case of error (memory or malformed document), 'true' otherwise.
+ */
+int XMLDoc_parse_buffer_len_SAX(const SXML_CHAR* buffer, size_t len, const SXML_CHAR* name, const SAX_Callbacks* sax, void* user);
+
+/*
+ Same as 'XMLDoc_parse_buffer_len_SAX' using the context 'ctx', or the default context if NULL.
+ */
+int XMLDoc_parse_buffer_len_SAX_ctx(const SXML_CHAR* buffer, size_t len, const SXML_CHAR* name, const SAX_Callbacks* sax, void* user, const XMLContext* ctx);
+
+/*
+ Parse an XML document from a mutable memory buffer 'buffer' that can be given a name 'name',
+ calling SAX callbacks given in the 'sax' structure.
+ Parsing is performed in-situ: tag names, attribute names and values and texts are NUL-terminated
+ inside 'buffer' and the nodes and text given to callbacks point there, so no copy is made.
+ Attribute values have their HTML escape sequences converted in place.
+ The 'insitu' member of the 'SAX_Data' given to callbacks is 'true' so that they know these
+ strings stay valid (as long as 'buffer' is) after the callback returns.
+ 'user' is a user-given pointer that will be given back to all callbacks.
+ Return 'false' in case of error (memory or malformed document), 'true' otherwise.
+ */
+int XMLDoc_parse_buffer_insitu_SAX(SXML_CHAR* buffer, const SXML_CHAR* name, const SAX_Callbacks* sax, void* user);
+
+/*
+ Parse an XML document from a given 'filename' mapped in memory, calling SAX callbacks given in
+ the 'sax' structure. See 'XMLDoc_parse_mmap_DOM_text_as_nodes' for mapping details.
+ 'user' is a user-given pointer that will be given back to all callbacks.
+ Return 'false' in case of error (memory or unavailable filename, malformed document), 'true' otherwise.
+ */
+int XMLDoc_parse_mmap_SAX(const SXML_CHAR* filename, const SAX_Callbacks* sax, void* user);
+
+/*
+ Parse an XML document from a memory buffer 'buffer' that can be given a name 'name',
+ calling view callbacks given in the 'sax' structure. 'buffer' is not modified and views
+ given to callbacks point inside it.
+ 'user' is a user-given pointer that will be given back to all callbacks.
+ Return 'false' in case of error (memory or malformed document), 'true' otherwise.
+ */
+int XMLDoc_parse_buffer_SAX_view(const SXML_CHAR* buffer, const SXML_CHAR* name, const SAX_View_Callbacks* sax, void* user);
+
+/*
+ Parse an XML document from a given 'filename' mapped in memory (see 'XMLDoc_parse_mmap_DOM_text_as_nodes'),
+ calling view callbacks given in the 'sax' structure. Views point inside the mapping and are only
+ valid during the callback.
+ 'user' is a user-given pointer that will be given back to all callbacks.
+ Return 'false' in case of error (memory or unavailable filename, malformed document), 'true' otherwise.
+ */
+int XMLDoc_parse_mmap_SAX_view(const SXML_CHAR* filename, const SAX_View_Callbacks* sax, void* user);
+
+/*
+ Parse an XML document read from the custom data source 'src' (see 'XMLDataSource'), that can be given
+ a name 'name', calling SAX callbacks given in the 'sax' structure. Characters are read by blocks and
+ parsed as they come, so that the whole document is never held in memory.
+ 'src' is not closed (see 'XMLDataSource_close').
+ 'user' is a user-given pointer that will be given back to all callbacks.
+ Return 'false' in case of error (memory or malformed document), 'true' otherwise.
+ */
+int XMLDoc_parse_source_SAX(XMLDataSource* src, const SXML_CHAR* name, const SAX_Callbacks* sax, void* user);
+
+/*
+ Same as 'XMLDoc_parse_source_SAX' using the context 'ctx' (see 'XMLContext'), or the default context if NULL.
+ */
+int XMLDoc_parse_source_SAX_ctx(XMLDataSource* src, const SXML_CHAR* name, const SAX_Callbacks* sax, void* user, const XMLContext* ctx);
+
+/*
+ Same as 'XMLDoc_parse_buffer_DOM_text_as_nodes' for a document read from the custom data source
+ 'src', which is not closed.
+ Return 'false' in case of error (memory or malformed document), 'true' otherwise.
+ */
+int XMLDoc_parse_source_DOM_text_as_nodes(XMLDataSource* src, const SXML_CHAR* name, XMLDoc* doc, int text_as_nodes);
+
+#define XMLDoc_parse_source_DOM(src, name, doc) XMLDoc_parse_source_DOM_text_as_nodes(src, name, doc, 0)
+
+/*
+ Same as 'XMLDoc_parse_source_DOM_text_as_nodes' using the context 'ctx' (see 'XMLContext'), or the
+ default context if NULL.
+ */
+int XMLDoc_parse_source_DOM_ctx(XMLDataSource* src, const SXML_CHAR* name, XMLDoc* doc, int text_as_nodes, const XMLContext* ctx);
+
+/*
+ Call the 'close' function of 'src', if any.
+ Return 'false' if 'src' is NULL.
+ */
+int XMLDataSource_close(XMLDataSource* src);
+
+#ifdef SXMLC_ZLIB
+/*
+ Initialize 'src' to read the gzip-compressed file 'filename' (plain files are read as they are),
+ inflating it as it is parsed. Needs zlib, enabled by defining 'SXMLC_ZLIB'.
+ With 'SXMLC_UNICODE', each byte is read as a character.
+ 'XMLDataSource_close' should be called to close the file.
+ Return 'false' if the file cannot be opened.
+ */
+int XMLDataSource_init_gzip(XMLDataSource* src, const char* filename);
+#endif
+
 /*
  Parse an XML file using the DOM implementation.
  */
@@ -696,6 +1196,365 @@ int XMLDoc_parse_buffer_SAX(const SXML_CHAR* buffer, const SXML_CHAR* name, cons
 
 
 
+/* --- Push parser --- */
+
+/*
+ Tag found by the tokenizer, which views point inside the characters being parsed.
+ 'attributes' is kept from one tag to the other and only grows when a tag has more attributes.
+ */
+typedef struct _XMLTagView {
+	XMLView tag;
+	TagType tag_type;
+	XMLAttributeView* attributes;
+	int n_attributes;
+	int sz_attributes;
+} XMLTagView;
+
+/*
+ Resumable tokenizer splitting characters into text followed by a tag, used by the parsers.
+ Characters can be added after a tag was found incomplete: the tokenizer then resumes scanning where
+ it stopped, in the same state, instead of parsing the whole tag again. Each character is then scanned
+ a bounded number of times, whatever the size of the tag and the number of '>' it contains.
+ All members are for internal use.
+ */
+typedef struct _XMLTokenizer {
+	SXML_CHAR* buf;		/* Characters to tokenize */
+	size_t len;			/* Number of characters in 'buf' */
+	size_t sz_buf;		/* Allocated size of 'buf', 0 when 'buf' was given by the caller */
+	size_t pos;			/* Start of the current text */
+	size_t txt_end;		/* Start of the tag following the current text (its '<'), once found */
+	size_t scan;		/* Where scanning resumes */
+	int state;			/* Scanning state */
+	int end_tag;		/* When scanning an element, 'true' for '</tag>' */
+	SXML_CHAR quote;	/* When scanning an element, quote of the attribute value being scanned, '=' after an '=' or NULC */
+	const SXML_CHAR* end_str;	/* When scanning a special tag, its end */
+	int len_end_str;
+	int n_lines;		/* Line breaks in the text scanned so far, unless lines are lazy */
+	size_t offset;		/* Offset in the document of 'buf[0]' */
+	size_t line_off;	/* With lazy lines, offset up to which line breaks were counted */
+	int line_cnt;		/* Line breaks before 'line_off' */
+	size_t line_start;	/* Offset of the start of the line containing 'line_off' */
+	int eos;			/* 'true' when no more characters will be added */
+	ParseError error;	/* Error of the last tokenizing */
+	XMLView text;		/* Text before the last tag found */
+	XMLTagView tv;		/* Last tag found */
+	int depth;			/* Number of nodes opened so far and not ended */
+	int skip;			/* Depth inside a subtree being skipped, 0 when not skipping */
+	const XMLContext* ctx;
+} XMLTokenizer;
+
+/*
+ Push parser: XML is given by chunks of any size through 'XMLParser_feed', and SAX callbacks are called
+ as soon as texts and tags are complete. Only the unfinished text or tag at the end of a chunk is kept
+ until the next one, so memory scales with the largest tag rather than the whole document.
+ All members are for internal use.
+ */
+typedef struct _XMLParser {
+	XMLTokenizer tok;
+	const SAX_Callbacks* sax;		/* Callbacks, or NULL to call view callbacks 'vsax' */
+	const SAX_View_Callbacks* vsax;
+	SAX_Data* sd;		/* Data given to callbacks ('data' for push parsers) */
+	int in_place;		/* 'true' when strings given to 'sax' can be NUL-terminated inside 'tok.buf' */
+	SXML_CHAR* line;	/* Otherwise, copy of the current text and tag */
+	size_t sz_line;
+	XMLNode node;		/* Node given to 'sax' callbacks, which strings point inside 'tok.buf' or 'line' */
+	int ret;			/* 'false' when an error occurred */
+	int started;		/* 'false' when the 'start_doc' callback stopped parsing */
+	int done;			/* 'true' when parsing is over (error, or stopped by a callback) */
+	SAX_Data data;
+
+	/* Keep 'init_value' as the last member */
+	int init_value;	/* Initialized to 'XML_INIT_DONE' to indicate that parser has been initialized properly */
+} XMLParser;
+
+/*
+ Initialize 'parser' to parse a document that can be given a name 'name', calling SAX callbacks
+ given in the 'sax' structure. The 'start_doc' callback is called immediately.
+ 'user' is a user-given pointer that will be given back to all callbacks.
+ 'XMLParser_finish' should be called once the whole document was given, to release memory.
+ Return 'false' when 'parser' or 'sax' is NULL.
+ */
+int XMLParser_init(XMLParser* parser, const SXML_CHAR* name, const SAX_Callbacks* sax, void* user);
+
+/*
+ Same as 'XMLParser_init' using the context 'ctx' (see 'XMLContext'), or the default context if NULL.
+ 'ctx' should not be changed or released until 'XMLParser_finish' is called.
+ */
+int XMLParser_init_ctx(XMLParser* parser, const SXML_CHAR* name, const SAX_Callbacks* sax, void* user, const XMLContext* ctx);
+
+/*
+ Give the next 'len' characters 'chunk' of the document to 'parser', which calls the callbacks for
+ all the texts and tags completed by 'chunk'. Chunks can end anywhere, even inside a tag.
+ 'chunk' does not need to be NUL-terminated and is not used after the function returns.
+ Return 'false' when parsing is over (error, or stopped by a callback) and further chunks are ignored,
+ 'true' otherwise.
+ */
+int XMLParser_feed(XMLParser* parser, const SXML_CHAR* chunk, size_t len);
+
+/*
+ Tell 'parser' that the whole document was given: the last text and tag are parsed, the 'end_doc'
+ callback is called and 'parser' memory is released.
+ Return 'false' in case of error (memory, malformed or incomplete document), 'true' otherwise.
+ */
+int XMLParser_finish(XMLParser* parser);
+
+/* --- Pull reader --- */
+
+/*
+ Pull reader: instead of having callbacks called, the document is read event by event
+ with 'XMLReader_next', and the current tag, attributes and text are available through accessors.
+ Strings are given as views on the characters being parsed (see 'XMLView'), which are valid until
+ the next call to 'XMLReader_next'. No allocation is made per event.
+ All members are for internal use.
+ */
+typedef struct _XMLReader {
+	XMLTokenizer tok;
+	FILE* f;			/* File being read, NULL when reading a buffer */
+	DataSourceBlock ds;	/* Block reader on 'f' */
+	const SXML_CHAR* name;
+	int line_num;
+	int n_open;			/* Number of father nodes started and not ended */
+	int depth;			/* Depth of the current event */
+	int step;			/* Events left to give for the last text and tag found */
+	XMLEvent event;		/* Current event */
+	ParseError error;
+
+	/* Keep 'init_value' as the last member */
+	int init_value;	/* Initialized to 'XML_INIT_DONE' to indicate that reader has been initialized properly */
+} XMLReader;
+
+/*
+ Initialize 'reader' to read file 'filename'.
+ Return 'false' if the file could not be opened or for memory error.
+ */
+int XMLReader_open_file(XMLReader* reader, const SXML_CHAR* filename);
+
+/*
+ Initialize 'reader' to read memory buffer 'buffer' that can be given a name 'name'.
+ 'buffer' is not copied and should be kept until 'reader' is closed.
+ Return 'false' if 'reader' or 'buffer' is NULL.
+ */
+int XMLReader_open_buffer(XMLReader* reader, const SXML_CHAR* buffer, const SXML_CHAR* name);
+
+/*
+ Close 'reader', releasing its memory and file.
+ */
+int XMLReader_close(XMLReader* reader);
+
+/*
+ Read the next event: 'XML_EVENT_START_NODE', 'XML_EVENT_END_NODE' (immediately after the start for
+ nodes other than 'TAG_FATHER', as SAX callbacks) or 'XML_EVENT_TEXT'.
+ Return 'XML_EVENT_END_DOC' when the whole document has been read, or 'XML_EVENT_ERROR' in case of
+ error (see 'XMLReader_get_error'). Both are then returned by further calls.
+ */
+XMLEvent XMLReader_next(XMLReader* reader);
+
+/*
+ When the current event is a node start, read all its children (if any) up to its end,
+ which becomes the current event.
+ Return 'false' when the current event is not a node start or in case of error, 'true' otherwise.
+ */
+int XMLReader_skip_subtree(XMLReader* reader);
+
+/*
+ Return the tag name (or the content of special tags like comments) of the current node event,
+ or NULL if the current event is not a node start or end.
+ */
+const XMLView* XMLReader_get_tag(const XMLReader* reader);
+
+/*
+ Return the type of the current node, 'TAG_NONE' if the current event is not a node start or end.
+ */
+TagType XMLReader_get_tag_type(const XMLReader* reader);
+
+/*
+ Return the number of attributes of the current node start and set '*attributes' to them,
+ if not NULL. Attribute values are raw (see 'XMLAttributeView').
+ */
+int XMLReader_get_attributes(const XMLReader* reader, const XMLAttributeView** attributes);
+
+/*
+ Return the raw value of attribute 'name' of the current node start, or NULL if there is none.
+ */
+const XMLView* XMLReader_get_attribute(const XMLReader* reader, const SXML_CHAR* name);
+
+/*
+ Return the raw text of the current text event, or NULL if the current event is not text.
+ */
+const XMLView* XMLReader_get_text(const XMLReader* reader);
+
+/*
+ Return the depth of the current event: the number of father nodes it is inside of.
+ */
+int XMLReader_get_depth(const XMLReader* reader);
+
+/*
+ Return the line number in the document of the current event.
+ */
+int XMLReader_get_line(const XMLReader* reader);
+
+/*
+ Return the error that stopped reading, 'PARSE_ERR_NONE' if none.
+ */
+ParseError XMLReader_get_error(const XMLReader* reader);
+
+/* --- Tape documents --- */
+
+/*
+ Read-only document form, for documents that are loaded once and then only read or searched.
+ All nodes are stored in a single array in document order and reference their strings, stored
+ once in a single pool, by offsets. Nodes are referred to by their index in the tape, -1 standing
+ for "no node". Tag and attribute names are stored once however many nodes use them.
+ */
+
+/*
+ A node of a tape. Its descendants are stored right after it, so its first child (if any) is at
+ index + 1 and its next sibling (if any) is at 'end'.
+ */
+typedef struct _XMLTapeNode {
+	int tag;			/* Offset of the tag name (or content of special tags like comments) in 'strings' */
+	int text;			/* Offset of the text inside the node in 'strings', -1 if none */
+	int father;			/* Index of the father node, -1 for document nodes (prolog, comments, root nodes) */
+	int end;			/* Index following the last descendant of the node */
+	int attributes;		/* Index of the first attribute of the node in 'attributes' */
+	int n_attributes;
+	TagType tag_type;
+} XMLTapeNode;
+
+/*
+ An attribute of a tape node, given as offsets in 'strings'.
+ */
+typedef struct _XMLTapeAttribute {
+	int name;
+	int value;
+} XMLTapeAttribute;
+
+typedef struct _XMLTape {
+	XMLTapeNode* nodes;				/* Nodes of the document, in document order */
+	int n_nodes;
+	int sz_nodes;					/* Allocated size of 'nodes' */
+	XMLTapeAttribute* attributes;	/* Attributes of all nodes, in document order */
+	int n_attributes;
+	int sz_attributes;				/* Allocated size of 'attributes' */
+	SXML_CHAR* strings;				/* Pool of all NUL-terminated strings of the document */
+	int len_strings;				/* Number of characters used in 'strings' */
+	int sz_strings;					/* Allocated size of 'strings' (in characters) */
+	int i_root;						/* Index of first root node, -1 if document is empty */
+
+	/* Keep 'init_value' as the last member */
+	int init_value;	/* Initialized to 'XML_INIT_DONE' to indicate that tape has been initialized properly */
+} XMLTape;
+
+/*
+ Set of SAX callbacks used by 'XMLTape_parse_file', to build a tape from another SAX source
+ (see 'DOM_through_SAX'): initialize the 'tape' member and give this struct as the 'user' data pointer.
+ Text is concatenated to node text (see 'XMLDoc_parse_file_DOM_text_as_nodes').
+ */
+typedef struct _TAPE_through_SAX {
+	XMLTape* tape;		/* Tape to fill up */
+	int current;		/* For internal use (index of current father node) */
+	SXML_CHAR* text;	/* For internal use (text of the nodes being built, as a stack) */
+	size_t len_text;
+	size_t sz_text;
+	size_t* levels;		/* For internal use (start of the text of each node being built in 'text') */
+	int n_levels;
+	int sz_levels;
+	int* names;			/* For internal use (hash table of the offsets of tag and attribute names) */
+	int n_names;
+	int sz_names;
+	ParseError error;	/* For internal use (parse status) */
+	int line_error;		/* For internal use (line number when error occurred) */
+} TAPE_through_SAX;
+
+int TAPEXMLDoc_doc_start(SAX_Data* sd);
+int TAPEXMLDoc_node_start(const XMLNode* node, SAX_Data* sd);
+int TAPEXMLDoc_node_text(SXML_CHAR* text, SAX_Data* sd);
+int TAPEXMLDoc_node_end(const XMLNode* node, SAX_Data* sd);
+int TAPEXMLDoc_parse_error(ParseError error_num, int line_number, SAX_Data* sd);
+int TAPEXMLDoc_doc_end(SAX_Data* sd);
+
+/*
+ Initialize 'sax' with the tape building callbacks.
+ */
+int SAX_Callbacks_init_tape(SAX_Callbacks* sax);
+
+/*
+ Initialize 'tape' as an empty tape.
+ Return 'false' when 'tape' is NULL.
+ */
+int XMLTape_init(XMLTape* tape);
+
+/*
+ Free 'tape' memory. It can be reused after being initialized again.
+ */
+int XMLTape_free(XMLTape* tape);
+
+/*
+ Load the XML file 'filename' into 'tape', which should have been initialized by 'XMLTape_init'
+ and is freed on error. Its arrays are then trimmed to their exact sizes.
+ Return 'false' in case of error (memory or unavailable filename, malformed document), 'true' otherwise.
+ */
+int XMLTape_parse_file(const SXML_CHAR* filename, XMLTape* tape);
+
+/*
+ Same as 'XMLTape_parse_file' using the context 'ctx' (see 'XMLContext'), or the default context if NULL.
+ */
+int XMLTape_parse_file_ctx(const SXML_CHAR* filename, XMLTape* tape, const XMLContext* ctx);
+
+/*
+ Same as 'XMLTape_parse_file' for the memory buffer 'buffer' that can be given a name 'name'.
+ */
+int XMLTape_parse_buffer(const SXML_CHAR* buffer, const SXML_CHAR* name, XMLTape* tape);
+
+/*
+ Return the index of the first root node of 'tape', or -1 if there is none or 'tape' is invalid.
+ */
+int XMLTape_root(const XMLTape* tape);
+
+/*
+ Return the index of the father of node 'i_node', or -1 if it is a document node or invalid.
+ */
+int XMLTape_father(const XMLTape* tape, int i_node);
+
+/*
+ Return the index of the first child of node 'i_node', or -1 if it has none or is invalid.
+ */
+int XMLTape_first_child(const XMLTape* tape, int i_node);
+
+/*
+ Return the index of the next sibling of node 'i_node', or -1 if it is invalid, the last child or
+ a document node (as 'XMLNode_next_sibling').
+ */
+int XMLTape_next_sibling(const XMLTape* tape, int i_node);
+
+/*
+ Return the index of the previous sibling of node 'i_node', or -1 if it is invalid, the first child
+ or a document node (as 'XMLNode_prev_sibling').
+ */
+int XMLTape_prev_sibling(const XMLTape* tape, int i_node);
+
+/*
+ Return the index of the next node in XML order i.e. first child or next sibling, or -1
+ if 'i_node' is invalid or the end of its root node is reached (as 'XMLNode_next').
+ */
+int XMLTape_next(const XMLTape* tape, int i_node);
+
+/*
+ Return the tag name of node 'i_node', or NULL if it is invalid.
+ */
+const SXML_CHAR* XMLTape_get_tag(const XMLTape* tape, int i_node);
+
+/*
+ Return the text of node 'i_node', or NULL if it has none or is invalid.
+ */
+const SXML_CHAR* XMLTape_get_text(const XMLTape* tape, int i_node);
+
+/*
+ Return the value of the attribute 'attr_name' of node 'i_node', or NULL if there is none or
+ 'i_node' is invalid.
+ */
+const SXML_CHAR* XMLTape_get_attribute(const XMLTape* tape, int i_node, const SXML_CHAR* attr_name);
+
 /* --- Utility functions --- */
 
 /*
@@ -704,11 +1563,40 @@ int XMLDoc_parse_buffer_SAX(const SXML_CHAR* buffer, const SXML_CHAR* name, cons
  */
 int _bgetc(DataSourceBuffer* ds);
 int _beob(DataSourceBuffer* ds);
+
+/*
+ Set the number of characters read at once from files by the parser (when 'sz' > 0).
+ Return the previous block size.
+ */
+int XML_set_read_block_size(int sz);
+
+/*
+ Initialize 'ds' to read data source 'in' of type 'in_type' by blocks of 'sz_blk' characters
+ (or the size given to 'XML_set_read_block_size' if 'sz_blk' <= 0).
+ Return 'false' on invalid arguments or memory error.
+ */
+int DataSourceBlock_init(DataSourceBlock* ds, void* in, DataSourceType in_type, int sz_blk);
+
+/*
+ Release memory allocated by 'DataSourceBlock_init'. The underlying data source is not closed.
+ For buffer data sources, its 'cur_pos' is updated to the characters actually consumed.
+ */
+int DataSourceBlock_free(DataSourceBlock* ds);
+
+/*
+ Same as '_bgetc' and '_beob' for block-buffered data sources.
+ */
+int _blkgetc(DataSourceBlock* ds);
+int _blkeob(DataSourceBlock* ds);
+
 /*
  Reads a line from data source 'in', eventually (re-)allocating a given buffer 'line'.
  Characters read will be stored in 'line' starting at 'i0' (this allows multiple calls to
  'read_line_alloc' on the same 'line' buffer without overwriting it at each call).
  'in_type' specifies the type of data source to be read: 'in' is 'FILE*' if 'in_type'
+ is 'DATA_SOURCE_FILE', 'DataSourceBuffer*' if 'DATA_SOURCE_BUFFER' and 'DataSourceBlock*'
+ if 'DATA_SOURCE_BLOCK' (in which case characters are scanned directly inside the block).
+ Custom data sources ('DATA_SOURCE_CUSTOM') have to be given through a 'DataSourceBlock'.
  'sz_line' is the size of the buffer 'line' if previously allocated. 'line' can point
  to NULL, in which case it will be allocated '*sz_line' bytes. After the function returns,
  '*sz_line' is the actual buffer size. This allows multiple calls to this function using the
@@ -65,6 +65,7 @@ int XMLSearch_init(XMLSearch* search)
 	search->next = NULL;
 	search->prev = NULL;
 	search->stop_at = INVALID_XMLNODE_POINTER; /* Because 'NULL' can be a valid value */
+	search->tape_stop_at = -1;
 	search->init_value = XML_INIT_DONE;
 	
 	return true;
@@ -436,7 +437,7 @@ int XMLSearch_init_from_XPath(const SXML_CHAR* xpath, XMLSearch* search)
 	return true;
 }
 
-static int _attribute_matches(XMLAttribute* to_test, XMLAttribute* pattern)
+static int _attribute_matches(XMLAttribute* to_test, XMLAttribute* pattern, REGEXPR_COMPARE compare)
 {
 	if (to_test == NULL && pattern == NULL)
 		return true;
@@ -449,7 +450,7 @@ static int _attribute_matches(XMLAttribute* to_test, XMLAttribute* pattern)
 		return true;
 
 	/* Test on name fails => no match */
-	if (!regstrcmp_search(to_test->name, pattern->name))
+	if (!compare(to_test->name, pattern->name))
 		return false;
 
 	/* No test on value => match */
@@ -457,29 +458,37 @@ static int _attribute_matches(XMLAttribute* to_test, XMLAttribute* pattern)
 		return true;
 
 	/* Test on value according to pattern "equal" attribute */
-	return regstrcmp_search(to_test->value, pattern->value) == pattern->active ? true : false;
+	return compare(to_test->value, pattern->value) == pattern->active ? true : false;
 }
 
-int XMLSearch_node_matches(const XMLNode* node, const XMLSearch* search)
+/*
+ Function comparing strings in context 'ctx', or the global one when 'ctx' is NULL.
+ */
+static REGEXPR_COMPARE _search_compare(const XMLContext* ctx)
 {
-	int i, j;
+	if (ctx == NULL)
+		return regstrcmp_search;
 
-	if (node == NULL)
-		return false;
+	return (ctx->regexpr_compare != NULL ? ctx->regexpr_compare : regstrcmp);
+}
 
-	if (search == NULL)
-		return true;
+/*
+ Check 'node' against 'search' only, not its father searches. Text criteria are skipped when 'check_text' is 'false'.
+ */
+static int _node_matches_1(const XMLNode* node, const XMLSearch* search, REGEXPR_COMPARE compare, int check_text)
+{
+	int i, j;
 
 	/* No comments, prolog, or such type of nodes are tested */
 	if (node->tag_type != TAG_FATHER && node->tag_type != TAG_SELF)
 		return false;
 
 	/* Check tag */
-	if (search->tag != NULL && !regstrcmp_search(node->tag, search->tag))
+	if (search->tag != NULL && !compare(node->tag, search->tag))
 		return false;
 
 	/* Check text */
-	if (search->text != NULL && !regstrcmp_search(node->text, search->text))
+	if (check_text && search->text != NULL && !compare(node->text, search->text))
 		return false;
 
 	/* Check attributes */
@@ -488,7 +497,7 @@ int XMLSearch_node_matches(const XMLNode* node, const XMLSearch* search)
 			for (j = 0; j < node->n_attributes; j++) {
 				if (!node->attributes[j].active)
 					continue;
-				if (_attribute_matches(&node->attributes[j], &search->attributes[i]))
+				if (_attribute_matches(&node->attributes[j], &search->attributes[i], compare))
 					break;
 			}
 			if (j >= node->n_attributes) /* All attributes where scanned without a successful match */
@@ -496,9 +505,26 @@ int XMLSearch_node_matches(const XMLNode* node, const XMLSearch* search)
 		}
 	}
 
+	return true;
+}
+
+/*
+ Check 'node' against 'search' and its father searches. Text criteria are skipped when 'check_text' is 'false'.
+ */
+static int _node_matches(const XMLNode* node, const XMLSearch* search, REGEXPR_COMPARE compare, int check_text)
+{
+	if (node == NULL)
+		return false;
+
+	if (search == NULL)
+		return true;
+
+	if (!_node_matches_1(node, search, compare, check_text))
+		return false;
+
 	/* 'node' matches 'search'. If there is a father search, its father must match it */
 	if (search->prev != NULL)
-		return XMLSearch_node_matches(node->father, search->prev);
+		return _node_matches(node->father, search->prev, compare, check_text);
 
 	/* TODO: Should a node match if search has no more 'prev' search and node father is still below the initial search ?
 	 Depends if XPath started with "//" (=> yes) or "/" (=> no).
@@ -507,7 +533,17 @@ int XMLSearch_node_matches(const XMLNode* node, const XMLSearch* search)
 	return true;
 }
 
-XMLNode* XMLSearch_next(const XMLNode* from, XMLSearch* search)
+int XMLSearch_node_matches(const XMLNode* node, const XMLSearch* search)
+{
+	return _node_matches(node, search, regstrcmp_search, true);
+}
+
+int XMLSearch_node_matches_ctx(const XMLNode* node, const XMLSearch* search, const XMLContext* ctx)
+{
+	return _node_matches(node, search, _search_compare(ctx), true);
+}
+
+static XMLNode* _search_next(const XMLNode* from, XMLSearch* search, REGEXPR_COMPARE compare)
 {
 	XMLNode* node;
 
@@ -523,7 +559,7 @@ XMLNode* XMLSearch_next(const XMLNode* from, XMLSearch* search)
 		search->stop_at = XMLNode_next_sibling(from);
 
 	for (node = XMLNode_next(from); node != search->stop_at; node = XMLNode_next(node)) { /* && node != NULL */
-		if (!XMLSearch_node_matches(node, search))
+		if (!_node_matches(node, search, compare, true))
 			continue;
 
 		/* 'node' is a matching node */
@@ -533,12 +569,520 @@ XMLNode* XMLSearch_next(const XMLNode* from, XMLSearch* search)
 			return node;
 
 		/* Run the search on 'node' children */
-		return XMLSearch_next(node, search->next);
+		return _search_next(node, search->next, compare);
 	}
 
 	return NULL;
 }
 
+XMLNode* XMLSearch_next(const XMLNode* from, XMLSearch* search)
+{
+	return _search_next(from, search, regstrcmp_search);
+}
+
+XMLNode* XMLSearch_next_ctx(const XMLNode* from, XMLSearch* search, const XMLContext* ctx)
+{
+	return _search_next(from, search, _search_compare(ctx));
+}
+
+/*
+ Same as '_node_matches' for node 'i_node' of 'tape'.
+ */
+static int _tape_node_matches(const XMLTape* tape, int i_node, const XMLSearch* search, REGEXPR_COMPARE compare)
+{
+	const XMLTapeNode* node;
+	const XMLTapeAttribute* attr;
+	XMLAttribute to_test;
+	int i, j;
+
+	if (i_node < 0)
+		return false;
+
+	if (search == NULL)
+		return true;
+
+	node = &tape->nodes[i_node];
+	if (node->tag_type != TAG_FATHER && node->tag_type != TAG_SELF)
+		return false;
+
+	if (search->tag != NULL && !compare(&tape->strings[node->tag], search->tag))
+		return false;
+
+	if (search->text != NULL && !compare(node->text < 0 ? NULL : &tape->strings[node->text], search->text))
+		return false;
+
+	if (search->attributes != NULL) {
+		attr = &tape->attributes[node->attributes];
+		to_test.active = true;
+		for (i = 0; i < search->n_attributes; i++) {
+			for (j = 0; j < node->n_attributes; j++) {
+				to_test.name = &tape->strings[attr[j].name];
+				to_test.value = &tape->strings[attr[j].value];
+				if (_attribute_matches(&to_test, &search->attributes[i], compare))
+					break;
+			}
+			if (j >= node->n_attributes)
+				return false;
+		}
+	}
+
+	if (search->prev != NULL)
+		return _tape_node_matches(tape, node->father, search->prev, compare);
+
+	return true;
+}
+
+int XMLSearch_tape_node_matches(const XMLTape* tape, int i_node, const XMLSearch* search)
+{
+	if (tape == NULL || tape->init_value != XML_INIT_DONE || i_node >= tape->n_nodes)
+		return false;
+
+	return _tape_node_matches(tape, i_node, search, regstrcmp_search);
+}
+
+static int _tape_search_next(const XMLTape* tape, int from, XMLSearch* search, REGEXPR_COMPARE compare)
+{
+	int i;
+
+	if (search == NULL || tape == NULL || tape->init_value != XML_INIT_DONE || from < 0 || from >= tape->n_nodes)
+		return -1;
+
+	/* Go down the last child search as fathers will be tested by '_tape_node_matches' */
+	for (; search->next != NULL; search = search->next) ;
+
+	/* Descendants of the initial 'from' node are the nodes up to its 'end' */
+	if (search->tape_stop_at < 0)
+		search->tape_stop_at = tape->nodes[from].end;
+
+	for (i = from + 1; i < search->tape_stop_at && i < tape->n_nodes; i++)
+		if (_tape_node_matches(tape, i, search, compare))
+			return i;
+
+	return -1;
+}
+
+int XMLSearch_tape_next(const XMLTape* tape, int from, XMLSearch* search)
+{
+	return _tape_search_next(tape, from, search, regstrcmp_search);
+}
+
+int XMLSearch_tape_next_ctx(const XMLTape* tape, int from, XMLSearch* search, const XMLContext* ctx)
+{
+	return _tape_search_next(tape, from, search, _search_compare(ctx));
+}
+
+/*
+ Projected DOM loading.
+ Nodes are built as the regular DOM would, then dropped when they end if they do not match a search
+ and have no kept child. Once a node might match a search (text aside), its whole content is kept until
+ it ends, when the match can be fully checked and its content pruned if it does not match.
+ */
+typedef struct _DOM_projection {
+	DOM_through_SAX dom; /* Keep first, as the DOM callbacks use 'sd->user' as a 'DOM_through_SAX*' */
+	XMLSearch** searches; /* Last search of each chain */
+	int n_searches;
+	REGEXPR_COMPARE compare;
+	int depth;
+	int capture_depth; /* Depth of the outermost node which content is kept until it ends, 0 when none */
+} DOM_projection;
+
+static int _projection_matches(const DOM_projection* proj, const XMLNode* node, int check_text)
+{
+	int i;
+
+	for (i = 0; i < proj->n_searches; i++)
+		if (_node_matches(node, proj->searches[i], proj->compare, check_text))
+			return true;
+
+	return false;
+}
+
+/*
+ Drop all nodes under 'node' that do not match a search and have no matching descendant.
+ Nodes matching a search are kept with all their content.
+ Return 'true' if 'node' should be kept.
+ */
+static int _projection_prune(const DOM_projection* proj, XMLNode* node)
+{
+	int i, n;
+
+	if (_projection_matches(proj, node, true))
+		return true;
+
+	for (i = n = 0; i < node->n_children; i++) {
+		if (_projection_prune(proj, node->children[i])) {
+			node->children[i]->i_child = n;
+			node->children[n++] = node->children[i];
+		} else
+			(void)XMLNode_delete(node->children[i]);
+	}
+	node->n_children = n;
+	if (n == 0 && node->children != NULL) {
+		__free(node->children);
+		node->children = NULL;
+		node->sz_children = 0;
+	}
+
+	return n > 0;
+}
+
+static int _projection_node_start(const XMLNode* node, SAX_Data* sd)
+{
+	DOM_projection* proj = (DOM_projection*)sd->user;
+
+	if (!DOMXMLDoc_node_start(node, sd))
+		return false;
+
+	proj->depth++;
+	if (proj->capture_depth == 0 && _projection_matches(proj, proj->dom.current, false))
+		proj->capture_depth = proj->depth;
+
+	return true;
+}
+
+static int _projection_node_end(const XMLNode* node, SAX_Data* sd)
+{
+	DOM_projection* proj = (DOM_projection*)sd->user;
+	XMLNode* ended = proj->dom.current;
+	XMLNode* father;
+	int keep;
+
+	if (!DOMXMLDoc_node_end(node, sd))
+		return false;
+
+	if (proj->capture_depth > 0 && proj->depth > proj->capture_depth) { /* Decided when the capturing node ends */
+		proj->depth--;
+		return true;
+	}
+
+	if (proj->depth == proj->capture_depth) {
+		proj->capture_depth = 0;
+		keep = _projection_prune(proj, ended);
+	} else /* Children were already pruned when they ended */
+		keep = ended->n_children > 0 || _projection_matches(proj, ended, true);
+	proj->depth--;
+
+	if (keep)
+		return true;
+
+	/* 'ended' is the last node of its father (or of the document) */
+	father = ended->father;
+	(void)XMLNode_delete(ended);
+	if (father != NULL) {
+		if (--father->n_children == 0) {
+			__free(father->children);
+			father->children = NULL;
+			father->sz_children = 0;
+		}
+	} else {
+		XMLDoc* doc = proj->dom.doc;
+		if (doc->i_root == --doc->n_nodes)
+			doc->i_root = -1;
+		if (doc->n_nodes == 0) {
+			__free(doc->nodes);
+			doc->nodes = NULL;
+			doc->sz_nodes = 0;
+		}
+	}
+
+	return true;
+}
+
+int XMLDoc_parse_file_DOM_projected(const SXML_CHAR* filename, XMLDoc* doc, XMLSearch** searches, int n_searches)
+{
+	return XMLDoc_parse_file_DOM_projected_ctx(filename, doc, searches, n_searches, NULL);
+}
+
+int XMLDoc_parse_file_DOM_projected_ctx(const SXML_CHAR* filename, XMLDoc* doc, XMLSearch** searches, int n_searches, const XMLContext* ctx)
+{
+	DOM_projection proj;
+	SAX_Callbacks sax;
+	int i, ret;
+
+	if (doc == NULL || filename == NULL || filename[0] == NULC || doc->init_value != XML_INIT_DONE || n_searches < 0 || (n_searches > 0 && searches == NULL))
+		return false;
+
+	/* Nodes are matched against the last search of each chain, fathers being checked recursively */
+	proj.searches = (XMLSearch**)__malloc((n_searches > 0 ? n_searches : 1) * sizeof(XMLSearch*));
+	if (proj.searches == NULL)
+		return false;
+	for (i = 0; i < n_searches; i++) {
+		XMLSearch* search = searches[i];
+		if (search == NULL || search->init_value != XML_INIT_DONE) {
+			__free(proj.searches);
+			return false;
+		}
+		for (; search->next != NULL; search = search->next) ;
+		proj.searches[i] = search;
+	}
+	proj.n_searches = n_searches;
+	proj.compare = _search_compare(ctx);
+	proj.depth = 0;
+	proj.capture_depth = 0;
+
+	proj.dom.doc = doc;
+	proj.dom.current = NULL;
+	proj.dom.text_as_nodes = false;
+
+	sx_strncpy(doc->filename, filename, SXMLC_MAX_PATH - 1);
+	doc->filename[SXMLC_MAX_PATH - 1] = NULC;
+
+#ifdef SXMLC_UNICODE
+	{
+		FILE* f = sx_fopen(filename, C2SX("rb"));
+		if (f != NULL) {
+			doc->bom_type = freadBOM(f, doc->bom, &doc->sz_bom);
+			sx_fclose(f);
+		}
+	}
+#endif
+
+	SAX_Callbacks_init_DOM(&sax);
+	sax.start_node = _projection_node_start;
+	sax.end_node = _projection_node_end;
+
+	ret = XMLDoc_parse_file_SAX_ctx(filename, &sax, &proj, ctx);
+	__free(proj.searches);
+	if (!ret) {
+		(void)XMLDoc_free(doc);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ Streaming search.
+ Each open node has the list of states '(query, position)' telling that the node matches search 'position'
+ of the query chain while its ancestors match the previous ones. States of a node are computed from the ones
+ of its father when it starts, and dropped when it ends.
+ */
+int XMLStreamSearch_init(XMLStreamSearch* ss, const XMLContext* ctx)
+{
+	if (ss == NULL)
+		return false;
+
+	ss->queries = NULL;
+	ss->n_queries = 0;
+	ss->states = NULL;
+	ss->n_states = 0;
+	ss->sz_states = 0;
+	ss->levels = NULL;
+	ss->n_levels = 0;
+	ss->sz_levels = 0;
+	ss->compare = _search_compare(ctx);
+	ss->init_value = XML_INIT_DONE;
+
+	return true;
+}
+
+/*
+ Remove all open levels, e.g. after a parsing error.
+ */
+static void _stream_search_reset(XMLStreamSearch* ss)
+{
+	for (; ss->n_levels > 0; ss->n_levels--)
+		(void)XMLNode_free(&ss->levels[ss->n_levels - 1].node);
+	ss->n_states = 0;
+}
+
+int XMLStreamSearch_free(XMLStreamSearch* ss)
+{
+	int i;
+
+	if (ss == NULL || ss->init_value != XML_INIT_DONE)
+		return false;
+
+	_stream_search_reset(ss);
+	for (i = 0; i < ss->n_queries; i++)
+		__free(ss->queries[i].path);
+	if (ss->queries != NULL) __free(ss->queries);
+	if (ss->states != NULL) __free(ss->states);
+	if (ss->levels != NULL) __free(ss->levels);
+	ss->init_value = 0;
+
+	return true;
+}
+
+int XMLStreamSearch_add_search(XMLStreamSearch* ss, XMLSearch* search, XMLSearch_match_callback on_match, void* user)
+{
+	XMLStreamQuery* pt;
+	XMLSearch* s;
+	int i, n;
+
+	if (ss == NULL || ss->init_value != XML_INIT_DONE || search == NULL || search->init_value != XML_INIT_DONE || on_match == NULL)
+		return -1;
+
+	for (; search->prev != NULL; search = search->prev) ;
+	for (n = 0, s = search; s != NULL; s = s->next) n++;
+
+	pt = (XMLStreamQuery*)__realloc(ss->queries, (ss->n_queries + 1) * sizeof(XMLStreamQuery));
+	if (pt == NULL)
+		return -1;
+	ss->queries = pt;
+	pt = &ss->queries[ss->n_queries];
+	pt->path = (XMLSearch**)__malloc(n * sizeof(XMLSearch*));
+	if (pt->path == NULL)
+		return -1;
+	pt->n_path = n;
+	pt->at_end = false;
+	for (i = 0, s = search; s != NULL; s = s->next) {
+		pt->path[i++] = s;
+		if (s->text != NULL)
+			pt->at_end = true;
+	}
+	pt->on_match = on_match;
+	pt->user = user;
+
+	return ss->n_queries++;
+}
+
+static int _stream_search_add_state(XMLStreamSearch* ss, int i_query, int i_search)
+{
+	if (ss->n_states >= ss->sz_states) {
+		int sz = ss->sz_states > 0 ? 2 * ss->sz_states : 16;
+		XMLStreamState* pt = (XMLStreamState*)__realloc(ss->states, sz * sizeof(XMLStreamState));
+		if (pt == NULL)
+			return false;
+		ss->states = pt;
+		ss->sz_states = sz;
+	}
+	ss->states[ss->n_states].i_query = i_query;
+	ss->states[ss->n_states].i_search = i_search;
+	ss->n_states++;
+
+	return true;
+}
+
+int XMLStreamSearch_doc_start(SAX_Data* sd)
+{
+	_stream_search_reset((XMLStreamSearch*)sd->user);
+
+	return true;
+}
+
+int XMLStreamSearch_node_start(const XMLNode* node, SAX_Data* sd)
+{
+	XMLStreamSearch* ss = (XMLStreamSearch*)sd->user;
+	XMLStreamLevel* level;
+	int i, i_father, n_father, keep_node;
+
+	if (ss->n_levels >= ss->sz_levels) {
+		int sz = ss->sz_levels > 0 ? 2 * ss->sz_levels : 16;
+		XMLStreamLevel* pt = (XMLStreamLevel*)__realloc(ss->levels, sz * sizeof(XMLStreamLevel));
+		if (pt == NULL)
+			return false;
+		ss->levels = pt;
+		ss->sz_levels = sz;
+	}
+	level = &ss->levels[ss->n_levels++];
+	level->i_state = ss->n_states;
+	level->keep_text = false;
+	XMLNode_init(&level->node);
+
+	/* No comments, prolog, or such type of nodes are tested, and they have no children */
+	if (node->tag_type != TAG_FATHER && node->tag_type != TAG_SELF)
+		return true;
+
+	/* Extend the states of the father node with 'node', then start new queries from it */
+	if (ss->n_levels > 1) {
+		i_father = ss->levels[ss->n_levels - 2].i_state;
+		n_father = level->i_state;
+		for (i = i_father; i < n_father; i++) {
+			XMLStreamQuery* query = &ss->queries[ss->states[i].i_query];
+			int i_search = ss->states[i].i_search + 1;
+			if (i_search < query->n_path && _node_matches_1(node, query->path[i_search], ss->compare, false)
+				&& !_stream_search_add_state(ss, ss->states[i].i_query, i_search))
+				return false;
+		}
+	}
+	for (i = 0; i < ss->n_queries; i++)
+		if (_node_matches_1(node, ss->queries[i].path[0], ss->compare, false) && !_stream_search_add_state(ss, i, 0))
+			return false;
+
+	/* Report matches that do not depend on text, keep what is needed by the other ones until the node ends */
+	keep_node = false;
+	for (i = level->i_state; i < ss->n_states; i++) {
+		XMLStreamQuery* query = &ss->queries[ss->states[i].i_query];
+		if (query->path[ss->states[i].i_search]->text != NULL)
+			level->keep_text = true;
+		if (ss->states[i].i_search < query->n_path - 1)
+			continue;
+		if (query->at_end)
+			keep_node = true;
+		else if (!query->on_match(node, sd, query->user))
+			return false;
+	}
+	if (keep_node && !XMLNode_copy(&level->node, node, false))
+		return false;
+
+	return true;
+}
+
+int XMLStreamSearch_node_text(SXML_CHAR* text, SAX_Data* sd)
+{
+	XMLStreamSearch* ss = (XMLStreamSearch*)sd->user;
+	XMLStreamLevel* level;
+
+	if (ss->n_levels == 0 || text == NULL || text[0] == NULC)
+		return true;
+
+	level = &ss->levels[ss->n_levels - 1];
+	if (level->keep_text && strcat_alloc(&level->node.text, text) == NULL)
+		return false;
+
+	return true;
+}
+
+int XMLStreamSearch_node_end(const XMLNode* node, SAX_Data* sd)
+{
+	XMLStreamSearch* ss = (XMLStreamSearch*)sd->user;
+	XMLStreamLevel* level;
+	int i, j, ret = true;
+
+	(void)node;
+	if (ss->n_levels == 0)
+		return true;
+
+	/* Report matches depending on text. Ancestors text is the one read so far */
+	level = &ss->levels[ss->n_levels - 1];
+	for (i = level->i_state; i < ss->n_states && ret; i++) {
+		XMLStreamQuery* query = &ss->queries[ss->states[i].i_query];
+		int i_search = ss->states[i].i_search;
+		if (!query->at_end || i_search < query->n_path - 1)
+			continue;
+		for (j = 0; j <= i_search; j++) {
+			XMLSearch* search = query->path[i_search - j];
+			if (search->text != NULL && !ss->compare(level[-j].node.text, search->text))
+				break;
+		}
+		if (j > i_search)
+			ret = query->on_match(&level->node, sd, query->user);
+	}
+
+	(void)XMLNode_free(&level->node);
+	ss->n_states = level->i_state;
+	ss->n_levels--;
+
+	return ret;
+}
+
+int SAX_Callbacks_init_stream_search(SAX_Callbacks* sax)
+{
+	if (sax == NULL)
+		return false;
+
+	sax->start_doc = XMLStreamSearch_doc_start;
+	sax->start_node = XMLStreamSearch_node_start;
+	sax->end_node = XMLStreamSearch_node_end;
+	sax->new_text = XMLStreamSearch_node_text;
+	sax->on_error = NULL;
+	sax->end_doc = NULL;
+	sax->all_event = NULL;
+
+	return true;
+}
+
 static SXML_CHAR* _get_XPath(const XMLNode* node, SXML_CHAR** xpath)
 {
 	int i, n, brackets, sz_xpath;
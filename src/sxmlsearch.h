@@ -81,15 +81,19 @@ typedef struct _XMLSearch {
 	 */
 	XMLNode* stop_at;
 
+	/*
+	 Internal use only. Index where tape searches stop (see 'XMLSearch_tape_next'), -1 prior to first search.
+	 */
+	int tape_stop_at;
+
 	/* Keep 'init_value' as the last member */
 	int init_value;	/* Initialized to 'XML_INIT_DONE' to indicate that document has been initialized properly */
 } XMLSearch;
 
-typedef int (*REGEXPR_COMPARE)(SXML_CHAR* str, SXML_CHAR* pattern);
-
 /*
  Set a new comparison function to evaluate whether a string matches a given pattern.
  The default one is the "regstrcmp" which handles limited regular expressions.
+ The function is shared by all searches but the '_ctx' ones, which use the one of their context instead.
  'fct' prototype is 'int fct(SXML_CHAR* str, SXML_CHAR* pattern)' where 'str' is the string to
  evaluate the match for and 'pattern' the pattern. It should return 'true' (=1) when
  'str' matches 'pattern' and 'false' (=0) when it does not.
@@ -199,6 +203,11 @@ int XMLSearch_init_from_XPath(const SXML_CHAR* xpath, XMLSearch* search);
  */
 int XMLSearch_node_matches(const XMLNode* node, const XMLSearch* search);
 
+/*
+ Same as 'XMLSearch_node_matches' using the comparison function of context 'ctx' (see 'XMLContext').
+ */
+int XMLSearch_node_matches_ctx(const XMLNode* node, const XMLSearch* search, const XMLContext* ctx);
+
 /*
  Search next matching node, according to search parameters given by 'search'.
  Search starts from node 'from' by scanning all its children, and going up to siblings,
@@ -217,6 +226,148 @@ int XMLSearch_node_matches(const XMLNode* node, const XMLSearch* search);
  */
 XMLNode* XMLSearch_next(const XMLNode* from, XMLSearch* search);
 
+/*
+ Same as 'XMLSearch_next' using the comparison function of context 'ctx' (see 'XMLContext').
+ */
+XMLNode* XMLSearch_next_ctx(const XMLNode* from, XMLSearch* search, const XMLContext* ctx);
+
+/*
+ Same as 'XMLSearch_node_matches' for node 'i_node' of 'tape' (see 'XMLTape').
+ */
+int XMLSearch_tape_node_matches(const XMLTape* tape, int i_node, const XMLSearch* search);
+
+/*
+ Same as 'XMLSearch_next' for the nodes of 'tape', which are scanned in order from node 'from'
+ to the end of its descendants.
+ Return the index of the next matching node, or -1 when no more nodes match or when an error occurred.
+ */
+int XMLSearch_tape_next(const XMLTape* tape, int from, XMLSearch* search);
+
+/*
+ Same as 'XMLSearch_tape_next' using the comparison function of context 'ctx' (see 'XMLContext').
+ */
+int XMLSearch_tape_next_ctx(const XMLTape* tape, int from, XMLSearch* search, const XMLContext* ctx);
+
+/*
+ Load the XML document from file 'filename' into 'doc', keeping only the nodes matching one of
+ the 'n_searches' search chains in 'searches' (with all their content) and their ancestors.
+ All other nodes are discarded as soon as they end, so memory holds only the kept nodes and the
+ nodes being parsed. Nodes are matched as with 'XMLSearch_node_matches' (any node of a chain
+ can be given), including root nodes. Text criteria on ancestor searches are checked on the
+ text read when the matching node ends. Prolog, comments and text outside kept nodes are dropped.
+ Text is concatenated to node text (see 'XMLDoc_parse_file_DOM_text_as_nodes').
+ 'doc' should have been initialized by 'XMLDoc_init' and is freed on error.
+ Return 'false' in case of error (memory, unexpected EOF or syntax), 'true' otherwise.
+ */
+int XMLDoc_parse_file_DOM_projected(const SXML_CHAR* filename, XMLDoc* doc, XMLSearch** searches, int n_searches);
+
+/*
+ Same as 'XMLDoc_parse_file_DOM_projected' using context 'ctx' to parse the file and compare strings
+ (see 'XMLContext').
+ */
+int XMLDoc_parse_file_DOM_projected_ctx(const SXML_CHAR* filename, XMLDoc* doc, XMLSearch** searches, int n_searches, const XMLContext* ctx);
+
+/*
+ Callback called by a streaming search when 'node' matches its search. 'user' is the pointer given
+ to 'XMLStreamSearch_add_search' and 'sd' the one of the SAX parsing.
+ Return 'false' to stop parsing.
+ */
+typedef int (*XMLSearch_match_callback)(const XMLNode* node, SAX_Data* sd, void* user);
+
+/*
+ Internal use only. A search chain run by a streaming search.
+ */
+typedef struct _XMLStreamQuery {
+	XMLSearch** path; /* Searches of the chain, from the first to the last one */
+	int n_path;
+	int at_end; /* Some search has text criteria: matches are reported when nodes end */
+	XMLSearch_match_callback on_match;
+	void* user;
+} XMLStreamQuery;
+
+/*
+ Internal use only. Node 'i_search' of 'i_query' path matches.
+ */
+typedef struct _XMLStreamState {
+	int i_query;
+	int i_search;
+} XMLStreamState;
+
+/*
+ Internal use only. Node being parsed.
+ */
+typedef struct _XMLStreamLevel {
+	int i_state; /* Index of the first state of the node */
+	int keep_text;
+	XMLNode node; /* Copy of the node, or only its text, when needed to report a match when it ends */
+} XMLStreamLevel;
+
+/*
+ Streaming search: run several search chains at once over SAX events, without building a DOM.
+ Each node being parsed keeps the states of the chains it matches, computed from the ones of its
+ father, so memory depends on the document depth and not on its size.
+ Usage:
+ - Initialize it with 'XMLStreamSearch_init' and add searches with 'XMLStreamSearch_add_search'.
+ - Parse the document through SAX with callbacks initialized by 'SAX_Callbacks_init_stream_search'
+   and the 'XMLStreamSearch*' as user pointer, or call the 'XMLStreamSearch_*' callbacks from your own
+   (they expect 'sd->user' to be the 'XMLStreamSearch*').
+ - Free it with 'XMLStreamSearch_free'.
+ */
+typedef struct _XMLStreamSearch {
+	XMLStreamQuery* queries;
+	int n_queries;
+	XMLStreamState* states; /* States of all nodes being parsed */
+	int n_states;
+	int sz_states;
+	XMLStreamLevel* levels; /* Nodes being parsed, from the root */
+	int n_levels;
+	int sz_levels;
+	REGEXPR_COMPARE compare;
+
+	/* Keep 'init_value' as the last member */
+	int init_value;	/* Initialized to 'XML_INIT_DONE' to indicate that the search has been initialized properly */
+} XMLStreamSearch;
+
+/*
+ Initialize an empty streaming search 'ss', comparing strings as the searches of context 'ctx'
+ (NULL for the global comparison function, see 'XMLSearch_set_regexpr_compare').
+ Return 'false' when 'ss' is NULL.
+ */
+int XMLStreamSearch_init(XMLStreamSearch* ss, const XMLContext* ctx);
+
+/*
+ Free all memory used by 'ss'. Searches given to 'XMLStreamSearch_add_search' are not freed.
+ Return 'false' when 'ss' is NULL or not initialized.
+ */
+int XMLStreamSearch_free(XMLStreamSearch* ss);
+
+/*
+ Add the search chain 'search' (any search of the chain can be given) to 'ss'. Nodes are matched
+ as with 'XMLSearch_node_matches'. 'search' is not copied and should be kept while 'ss' is used.
+ 'on_match' is called with 'user' on each matching node:
+ - when it starts if no search of the chain has text criteria. 'node' is the one given to the SAX
+   'start_node' callback, so 'sd->skip_subtree' can be set to skip its content.
+ - when it ends otherwise, with a copy of the node tag, attributes and text. Text criteria of
+   father searches are checked on the text read so far by the corresponding nodes.
+ 'node' has no father nor children and is only valid during the callback.
+ Return the index of the search in 'ss', or '-1' on invalid arguments or memory error.
+ */
+int XMLStreamSearch_add_search(XMLStreamSearch* ss, XMLSearch* search, XMLSearch_match_callback on_match, void* user);
+
+/*
+ SAX callbacks of a streaming search. 'sd->user' should be the 'XMLStreamSearch*'.
+ */
+int XMLStreamSearch_doc_start(SAX_Data* sd);
+int XMLStreamSearch_node_start(const XMLNode* node, SAX_Data* sd);
+int XMLStreamSearch_node_text(SXML_CHAR* text, SAX_Data* sd);
+int XMLStreamSearch_node_end(const XMLNode* node, SAX_Data* sd);
+
+/*
+ Initialize 'sax' with the streaming search callbacks.
+ Return 'false' when 'sax' is NULL.
+ */
+int SAX_Callbacks_init_stream_search(SAX_Callbacks* sax);
+
 /*
  Get 'node' XPath-like equivalent: 'tag[.="text", @attribute="value", ...]', potentially
  including father nodes XPathes.